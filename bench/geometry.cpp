@@ -0,0 +1,116 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <gclib/gc.hpp>
+
+// the same workloads on heaps with different line and block sizes
+
+namespace {
+	enum tag : uint8_t { tag_node, tag_buffer };
+	struct node {
+		tag t;
+		node *left;
+		node *right;
+		node(node *l, node *r) : t(tag_node), left(l), right(r) { }
+	};
+	/// size_t-aligned header followed by data bytes
+	struct buffer {
+		tag t;
+		uint32_t bytes;
+		node *owner;
+	};
+	struct policy {
+		static size_t size(void *obj) {
+			return *(tag *)obj == tag_node ? sizeof(node) : sizeof(buffer) + ((buffer *)obj)->bytes;
+		}
+		template<typename Visitor>
+		static void trace(void *obj, Visitor &visit) {
+			if (*(tag *)obj == tag_node) {
+				visit(&((node *)obj)->left);
+				visit(&((node *)obj)->right);
+			} else {
+				visit(&((buffer *)obj)->owner);
+			}
+		}
+	};
+
+	template<typename Gc>
+	node *build_tree(Gc &gc, int depth) {
+		if (depth == 0) {
+			return gc.template new_<node>(nullptr, nullptr);
+		}
+		gclib::handle_scope scope(gc);
+		gclib::handle<node> left = gc.handle_of(build_tree(gc, depth - 1));
+		gclib::handle<node> right = gc.handle_of(build_tree(gc, depth - 1));
+		node *out = gc.template new_<node>(nullptr, nullptr); // the allocation may move left and right
+		out->left = left.get();
+		out->right = right.get();
+		return out;
+	}
+	/// long lived binary trees, replaced one at a time, while short lived trees are built
+	template<typename Gc>
+	void trees(Gc &gc, int rounds) {
+		gclib::handle_scope scope(gc);
+		std::vector<gclib::handle<node>> kept;
+		for (int i = 0; i < 8; i++) {
+			kept.push_back(gc.handle_of(build_tree(gc, 14)));
+		}
+		for (int i = 0; i < rounds; i++) {
+			kept[i % kept.size()].set(build_tree(gc, 14));
+			for (int j = 0; j < 16; j++) {
+				build_tree(gc, 10);
+			}
+		}
+	}
+	/// buffers of random sizes (16 B to 4 KiB), about a tenth of them survive
+	template<typename Gc>
+	void buffers(Gc &gc, int rounds) {
+		gclib::handle_scope scope(gc);
+		std::vector<gclib::handle<buffer>> kept;
+		std::mt19937 rng(3);
+		std::uniform_int_distribution<uint32_t> sizes(16, 4096);
+		for (int i = 0; i < rounds * 20'000; i++) {
+			const uint32_t bytes = sizes(rng);
+			buffer *b = static_cast<buffer *>(gc.alloc(sizeof(buffer) + bytes));
+			b->t = tag_buffer;
+			b->bytes = bytes;
+			b->owner = nullptr;
+			if (rng() % 10 == 0) {
+				if (kept.size() < 4'096) {
+					kept.push_back(gc.handle_of(b));
+				} else {
+					kept[rng() % kept.size()].set(b);
+				}
+			}
+		}
+	}
+
+	template<typename Geometry>
+	void run(const char *name, int rounds) {
+		using geometry_gc = gclib::basic_gc<policy, Geometry>;
+		const auto measure = [&](auto &&workload, const char *workload_name) {
+			geometry_gc gc;
+			const auto start = std::chrono::steady_clock::now();
+			workload(gc, rounds);
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			std::printf("%-16s %-8s %10.1f %12.1f %12llu\n", name, workload_name, ms,
+				gc.block_count() * Geometry::block_size / 1024.0,
+				static_cast<unsigned long long>(gc.major_collection_count()));
+		};
+		measure([](geometry_gc &gc, int r) { trees(gc, r); }, "trees");
+		measure([](geometry_gc &gc, int r) { buffers(gc, r); }, "buffers");
+	}
+}
+
+int main(int argc, char **argv) {
+	const int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+	std::printf("%-16s %-8s %10s %12s %12s\n", "geometry", "workload", "ms", "block KiB", "collections");
+	run<gclib::heap_geometry<64, 32 * 1024>>("64 B / 32 KiB", rounds);
+	run<gclib::heap_geometry<128, 32 * 1024>>("128 B / 32 KiB", rounds);
+	run<gclib::heap_geometry<256, 32 * 1024>>("256 B / 32 KiB", rounds);
+	run<gclib::heap_geometry<128, 64 * 1024>>("128 B / 64 KiB", rounds);
+	run<gclib::heap_geometry<128, 256 * 1024, 8 * 1024>>("128 B / 256 KiB", rounds);
+	run<gclib::heap_geometry<256, 256 * 1024, 8 * 1024>>("256 B / 256 KiB", rounds);
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <gclib/gc.hpp>
+
+// serial mark throughput on heaps where following a reference mostly misses the cache: a linked list
+// whose nodes are linked in random order, and the same list with two random edges per node
+
+namespace {
+	enum tag : uint8_t { tag_node, tag_array };
+	struct node {
+		tag t;
+		node *next;
+		node *a;
+		node *b;
+		uint64_t payload;
+		node() : t(tag_node), next(nullptr), a(nullptr), b(nullptr), payload(0) { }
+	};
+	/// the nodes in allocation order, so that building the links doesn't need handles
+	struct node_array {
+		tag t;
+		size_t count;
+		node **nodes() { return reinterpret_cast<node **>(this + 1); }
+	};
+	struct policy {
+		static size_t size(void *obj) {
+			if (*static_cast<tag *>(obj) == tag_array) {
+				return sizeof(node_array) + static_cast<node_array *>(obj)->count * sizeof(node *);
+			}
+			return sizeof(node);
+		}
+		template<typename Visitor>
+		static void trace(void *obj, Visitor &visit) {
+			if (*static_cast<tag *>(obj) == tag_array) {
+				node_array *arr = static_cast<node_array *>(obj);
+				for (size_t i = 0; i < arr->count; i++) {
+					visit(&arr->nodes()[i]);
+				}
+				return;
+			}
+			node *n = static_cast<node *>(obj);
+			visit(&n->next);
+			visit(&n->a);
+			visit(&n->b);
+		}
+	};
+	using bench_gc = gclib::basic_gc<policy>;
+
+	node_array *alloc_array(bench_gc &gc, size_t count) {
+		node_array *arr = static_cast<node_array *>(gc.alloc(sizeof(node_array) + count * sizeof(node *)));
+		arr->t = tag_array;
+		arr->count = 0;
+		return arr;
+	}
+	/// allocates count nodes and returns the head of the shuffled list, the nodes are kept by arr meanwhile
+	node *build(bench_gc &gc, bench_gc::unique_root_type<node_array> &arr, size_t count, bool graph) {
+		for (size_t i = 0; i < count; i++) {
+			node *n = gc.new_<node>();
+			arr->nodes()[arr->count++] = n; // the nodes are only moved by collections, and none runs here
+		}
+		std::vector<size_t> order(count);
+		std::iota(order.begin(), order.end(), 0);
+		std::mt19937_64 rng(42);
+		std::shuffle(order.begin(), order.end(), rng);
+		node **nodes = arr->nodes();
+		for (size_t i = 0; i + 1 < count; i++) {
+			nodes[order[i]]->next = nodes[order[i + 1]];
+			if (graph) {
+				nodes[order[i]]->a = nodes[rng() % count];
+				nodes[order[i]]->b = nodes[rng() % count];
+			}
+		}
+		return nodes[order[0]];
+	}
+	void run(const char *name, size_t count, int repeats, bool graph) {
+		bench_gc gc;
+		gclib::gc_config config;
+		config.min_heap_bytes = SIZE_MAX / 2; // only the collections below
+		config.compact_ratio = SIZE_MAX; // nothing is evacuated, only marked
+		gc.set_config(config);
+		bench_gc::unique_root_type<node_array> arr(alloc_array(gc, count), &gc);
+		bench_gc::unique_root_type<node> head(build(gc, arr, count, graph), &gc);
+		arr = nullptr; // from now on, only the list keeps the nodes
+		gc.collect();
+		double seconds = 0;
+		uint64_t objects = 0;
+		uint64_t bytes = 0;
+		for (int i = 0; i < repeats; i++) {
+			gc.collect();
+			const gclib::collection_stats &stats = gc.last_collection_stats();
+			seconds += std::chrono::duration<double>(stats.phases.mark + stats.phases.root_scan).count();
+			objects += stats.marked_objects;
+			bytes += stats.marked_bytes;
+		}
+		std::printf("%-14s %10zu %12.2f %12.1f %10.1f\n", name, count, seconds * 1000 / repeats,
+			objects / seconds / 1e6, bytes / seconds / (1024 * 1024));
+	}
+}
+
+int main(int argc, char **argv) {
+	const size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4'000'000;
+	const int repeats = argc > 2 ? std::atoi(argv[2]) : 5;
+	std::printf("%-14s %10s %12s %12s %10s\n", "heap", "nodes", "ms/mark", "Mobjects/s", "MB/s");
+	run("shuffled list", count, repeats, false);
+	run("random graph", count, repeats, true);
+}
@@ -0,0 +1,101 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include <gclib/gc.hpp>
+
+// full collections of a binary tree with random cross edges, marked with an increasing number of threads
+
+namespace {
+	enum tag : uint8_t { tag_node };
+	struct node {
+		tag t;
+		node *left;
+		node *right;
+		node *cross;
+		node(node *l, node *r) : t(tag_node), left(l), right(r), cross(nullptr) { }
+	};
+	size_t bytes_of(void *) { return sizeof(node); }
+	std::optional<void **> next_ref(void *obj, node **after) {
+		node *n = static_cast<node *>(obj);
+		node **fields[] = { &n->left, &n->right, &n->cross };
+		size_t i = 0;
+		if (after != nullptr) {
+			while (fields[i] != after) { i++; }
+			i++;
+		}
+		for (; i < 3; i++) {
+			if (*fields[i] != nullptr) {
+				return reinterpret_cast<void **>(fields[i]);
+			}
+		}
+		return std::nullopt;
+	}
+	std::optional<void **> ref_begin(void *obj) { return next_ref(obj, nullptr); }
+	std::optional<void **> ref_next(void *obj, void **prev) { return next_ref(obj, reinterpret_cast<node **>(prev)); }
+
+	node *build_tree(gclib::void_gc &gc, int depth) {
+		if (depth == 0) {
+			return gc.new_<node>(nullptr, nullptr);
+		}
+		gclib::void_gc_uroot<node> left(build_tree(gc, depth - 1), &gc);
+		gclib::void_gc_uroot<node> right(build_tree(gc, depth - 1), &gc);
+		node *out = gc.new_<node>(nullptr, nullptr); // the allocation may move left and right
+		out->left = left.get();
+		out->right = right.get();
+		return out;
+	}
+}
+
+int main(int argc, char **argv) {
+	const int depth = argc > 1 ? std::atoi(argv[1]) : 20;
+	const int repeats = argc > 2 ? std::atoi(argv[2]) : 5;
+	const size_t max_threads = argc > 3 ? std::atoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gclib::void_gc_uroot<node> tree(build_tree(gc, depth), &gc);
+	// nothing is allocated while the cross edges are added, so the pointers in all stay valid
+	std::vector<node *> all;
+	std::vector<node *> stack{ tree.get() };
+	while (!stack.empty()) {
+		node *n = stack.back();
+		stack.pop_back();
+		all.push_back(n);
+		if (n->left) stack.push_back(n->left);
+		if (n->right) stack.push_back(n->right);
+	}
+	std::mt19937_64 rng(42);
+	for (node *n : all) {
+		n->cross = all[rng() % all.size()];
+	}
+	std::printf("depth %d, %zu objects, %llu blocks\n", depth, all.size(),
+		static_cast<unsigned long long>(gc.block_count()));
+	std::printf("%8s %12s %8s\n", "threads", "ms/collect", "speedup");
+	std::vector<size_t> thread_counts{ 1 };
+	for (size_t t = 2; t <= max_threads; t *= 2) {
+		thread_counts.push_back(t);
+	}
+	double serial_ms = 0;
+	uint64_t serial_live = 0;
+	for (size_t threads : thread_counts) {
+		gc.set_mark_threads(threads);
+		gc.collect();
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < repeats; i++) {
+			gc.collect();
+		}
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+		if (threads == 1) {
+			serial_ms = ms;
+			serial_live = gc.live_object_count();
+		} else if (gc.live_object_count() != serial_live) {
+			std::printf("live object count mismatch: %llu with %zu threads, %llu serial\n",
+				static_cast<unsigned long long>(gc.live_object_count()), threads,
+				static_cast<unsigned long long>(serial_live));
+			return 1;
+		}
+		std::printf("%8zu %12.3f %8.2f\n", threads, ms, serial_ms / ms);
+	}
+}
+
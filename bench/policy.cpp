@@ -0,0 +1,104 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <gclib/gc.hpp>
+
+// the tagged union workload of test/tu.cpp with std::function callbacks (void_gc and visitor_gc) and with a
+// static trace_policy
+
+namespace {
+	enum tag : uint8_t { tag_int, tag_link_ilist };
+	struct gcint {
+		tag t;
+		int data;
+		gcint(int d) : t(tag_int), data(d) { }
+	};
+	struct link_ilist {
+		tag t;
+		int data;
+		link_ilist *next;
+		link_ilist(int d) : t(tag_link_ilist), data(d), next(nullptr) { }
+	};
+	size_t bytes_of(void *obj) {
+		return *(tag *)obj == tag_int ? sizeof(gcint) : sizeof(link_ilist);
+	}
+	std::optional<void **> ref_begin(void *obj) {
+		if (*(tag *)obj == tag_link_ilist && ((link_ilist *)obj)->next) {
+			return (void **)&((link_ilist *)obj)->next;
+		}
+		return std::nullopt;
+	}
+	std::optional<void **> ref_next(void *, void **) { return std::nullopt; }
+	void trace_refs(void *obj, gclib::ref_list &list) {
+		if (*(tag *)obj == tag_link_ilist) {
+			list(&((link_ilist *)obj)->next);
+		}
+	}
+	struct tu_policy {
+		static size_t size(void *obj) { return bytes_of(obj); }
+		template<typename Visitor>
+		static void trace(void *obj, Visitor &visit) {
+			if (*(tag *)obj == tag_link_ilist) {
+				visit(&((link_ilist *)obj)->next);
+			}
+		}
+	};
+
+	struct result {
+		double build_ms;
+		double collect_ms;
+		uint64_t live;
+	};
+	/// builds 3 lists with garbage in between, then times full collections of everything that is left
+	template<typename Gc>
+	result run(Gc &gc, int nodes, int collects) {
+		const auto start = std::chrono::steady_clock::now();
+		std::mt19937 rng(7);
+		std::vector<typename Gc::template unique_root_type<link_ilist>> lists;
+		for (int i = 0; i < 3; i++) {
+			lists.push_back(gc.template make_unique<link_ilist>(i));
+		}
+		for (int i = 3; i < nodes; i++) {
+			auto &list = lists[rng() % 3];
+			link_ilist *node = gc.template new_<link_ilist>(i);
+			node->next = list.get();
+			list = typename Gc::template unique_root_type<link_ilist>(node, &gc);
+			gc.template new_<gcint>(i);
+		}
+		lists[2] = nullptr;
+		const auto built = std::chrono::steady_clock::now();
+		for (int i = 0; i < collects; i++) {
+			gc.collect();
+		}
+		const auto end = std::chrono::steady_clock::now();
+		return {
+			std::chrono::duration<double, std::milli>(built - start).count(),
+			std::chrono::duration<double, std::milli>(end - built).count() / collects,
+			gc.live_object_count()
+		};
+	}
+}
+
+int main(int argc, char **argv) {
+	const int nodes = argc > 1 ? std::atoi(argv[1]) : 1'000'000;
+	const int collects = argc > 2 ? std::atoi(argv[2]) : 10;
+	gclib::void_gc callback_gc(bytes_of, ref_begin, ref_next);
+	const result callbacks = run(callback_gc, nodes, collects);
+	gclib::visitor_gc visitor_gc(bytes_of, trace_refs);
+	const result visitor = run(visitor_gc, nodes, collects);
+	gclib::basic_gc<tu_policy> policy_gc;
+	const result policy = run(policy_gc, nodes, collects);
+	if (callbacks.live != policy.live || visitor.live != policy.live) {
+		std::printf("live object count mismatch: %llu with callbacks, %llu with the visitor, %llu with the policy\n",
+			static_cast<unsigned long long>(callbacks.live), static_cast<unsigned long long>(visitor.live),
+			static_cast<unsigned long long>(policy.live));
+		return 1;
+	}
+	std::printf("%d nodes, %llu live\n", nodes, static_cast<unsigned long long>(policy.live));
+	std::printf("%10s %12s %12s\n", "", "build ms", "ms/collect");
+	std::printf("%10s %12.3f %12.3f\n", "callbacks", callbacks.build_ms, callbacks.collect_ms);
+	std::printf("%10s %12.3f %12.3f\n", "visitor", visitor.build_ms, visitor.collect_ms);
+	std::printf("%10s %12.3f %12.3f\n", "policy", policy.build_ms, policy.collect_ms);
+}
@@ -0,0 +1,57 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <gclib/gc.hpp>
+
+// temporary roots on a hot path: unique_root (hash set insert and erase) against handles in a handle_scope
+
+namespace {
+	enum tag : uint8_t { tag_int };
+	struct gcint {
+		tag t;
+		int data;
+		gcint(int d) : t(tag_int), data(d) { }
+	};
+	size_t bytes_of(void *) { return sizeof(gcint); }
+	std::optional<void **> ref_begin(void *) { return std::nullopt; }
+	std::optional<void **> ref_next(void *, void **) { return std::nullopt; }
+
+	template<typename Fun>
+	double measure(int iterations, Fun &&fun) {
+		const auto start = std::chrono::steady_clock::now();
+		fun(iterations);
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+	}
+}
+
+int main(int argc, char **argv) {
+	const int iterations = argc > 1 ? std::atoi(argv[1]) : 1'000'000;
+	const int roots_per_iteration = argc > 2 ? std::atoi(argv[2]) : 4;
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	// one object reused as the value of all roots, so only the root bookkeeping is measured
+	gclib::void_gc_uroot<gcint> obj = gc.make_unique<gcint>(1);
+	long long sum = 0;
+	const double unique_root_ns = measure(iterations, [&](int n) {
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < roots_per_iteration; j++) {
+				gclib::void_gc_uroot<gcint> root(obj.get(), &gc);
+				gclib::void_gc_uroot<gcint> moved(std::move(root));
+				sum += moved->data;
+			}
+		}
+	});
+	const double handle_ns = measure(iterations, [&](int n) {
+		for (int i = 0; i < n; i++) {
+			gclib::handle_scope scope(gc);
+			for (int j = 0; j < roots_per_iteration; j++) {
+				gclib::handle<gcint> root = gc.handle_of(obj.get());
+				gclib::handle<gcint> copied = root;
+				sum += copied->data;
+			}
+		}
+	});
+	std::printf("%d roots per iteration (checksum %lld)\n", roots_per_iteration, sum);
+	std::printf("%12s %12s\n", "", "ns/iter");
+	std::printf("%12s %12.2f\n", "unique_root", unique_root_ns);
+	std::printf("%12s %12.2f\n", "handle", handle_ns);
+}
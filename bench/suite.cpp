@@ -0,0 +1,437 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+#include <gclib/gc.hpp>
+#include <gclib/util.hpp>
+
+// standard gc workloads on gclib and on malloc/free, with throughput, pause times and memory use
+
+namespace {
+	enum tag : uint8_t { tag_node, tag_link, tag_graph, tag_uvec_data };
+	struct node {
+		tag t = tag_node;
+		node *left = nullptr;
+		node *right = nullptr;
+		int32_t i = 0, j = 0;
+	};
+	struct link {
+		tag t = tag_link;
+		link *next = nullptr;
+		int64_t data = 0;
+	};
+	constexpr size_t graph_degree = 4;
+	struct graph_node {
+		tag t = tag_graph;
+		graph_node *edges[graph_degree] = { };
+		uint64_t payload = 0;
+	};
+	constexpr size_t uvec_tag = gclib::make_header(tag_uvec_data);
+	struct policy {
+		static size_t size(void *obj) {
+			switch (*(tag *)obj) {
+			case tag_node: return sizeof(node);
+			case tag_link: return sizeof(link);
+			case tag_graph: return sizeof(graph_node);
+			case tag_uvec_data: return gclib::bytes_vec_data<uint64_t>(obj);
+			}
+			return sizeof(tag);
+		}
+		template<typename Visitor>
+		static void trace(void *obj, Visitor &visit) {
+			switch (*(tag *)obj) {
+			case tag_node:
+				visit(&((node *)obj)->left);
+				visit(&((node *)obj)->right);
+				break;
+			case tag_link:
+				visit(&((link *)obj)->next);
+				break;
+			case tag_graph:
+				for (graph_node *&edge : ((graph_node *)obj)->edges) {
+					visit(&edge);
+				}
+				break;
+			case tag_uvec_data:
+				break;
+			}
+		}
+	};
+	using bench_gc = gclib::basic_gc<policy>;
+	using uvec = gclib::vector<uint64_t, uvec_tag, bench_gc>;
+
+	struct result {
+		const char *workload;
+		const char *heap;
+		uint64_t ops = 0;
+		double seconds = 0;
+		std::vector<double> pauses_ms;
+		uint64_t peak_rss_kib = 0;
+		uint64_t peak_blocks = 0;
+		uint64_t collections = 0;
+	};
+
+	/// sets the peak RSS of the process to the current RSS (only on linux)
+	void reset_peak_rss() {
+		if (FILE *f = std::fopen("/proc/self/clear_refs", "w")) {
+			std::fputs("5", f);
+			std::fclose(f);
+		}
+	}
+	uint64_t peak_rss_kib() {
+		if (FILE *f = std::fopen("/proc/self/status", "r")) {
+			char line[256];
+			unsigned long long kib = 0;
+			while (std::fgets(line, sizeof(line), f)) {
+				if (std::sscanf(line, "VmHWM: %llu kB", &kib) == 1) {
+					break;
+				}
+			}
+			std::fclose(f);
+			if (kib) {
+				return kib;
+			}
+		}
+#if defined(__unix__) || defined(__APPLE__)
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+		return usage.ru_maxrss / 1024;
+#else
+		return usage.ru_maxrss;
+#endif
+#else
+		return 0;
+#endif
+	}
+
+	/// a gc, which records its pauses and size while a workload runs
+	struct gc_heap {
+		static constexpr const char *name = "gclib";
+		bench_gc gc;
+		result &out;
+		uint64_t seen_pauses = 0;
+
+		explicit gc_heap(result &_out) : out(_out) { }
+		template<typename T> T *make() {
+			T *o = gc.new_<T>();
+			out.ops++;
+			poll();
+			return o;
+		}
+		/// called after every operation which may allocate
+		void poll() {
+			out.peak_blocks = std::max(out.peak_blocks, gc.block_count());
+			if (gc.pause_count() != seen_pauses) {
+				seen_pauses = gc.pause_count();
+				out.pauses_ms.push_back(std::chrono::duration<double, std::milli>(gc.last_pause()).count());
+			}
+		}
+		void finish() {
+			out.collections = gc.major_collection_count() + gc.minor_collection_count();
+		}
+	};
+	struct malloc_heap {
+		static constexpr const char *name = "malloc";
+		result &out;
+
+		explicit malloc_heap(result &_out) : out(_out) { }
+		template<typename T> T *make() {
+			out.ops++;
+			return new T();
+		}
+		void finish() { }
+	};
+
+	// GCBench (Boehm, Demers, Ellis): a long lived tree and array, while trees of growing depth are
+	// built top down and bottom up
+
+	void populate(gc_heap &h, int depth, gclib::handle<node> n) {
+		if (depth <= 0) {
+			return;
+		}
+		gclib::handle_scope scope(h.gc);
+		n->left = h.make<node>();
+		n->right = h.make<node>();
+		populate(h, depth - 1, h.gc.handle_of(n->left));
+		populate(h, depth - 1, h.gc.handle_of(n->right));
+	}
+	node *make_tree(gc_heap &h, int depth) {
+		if (depth <= 0) {
+			return h.make<node>();
+		}
+		gclib::handle_scope scope(h.gc);
+		gclib::handle<node> left = h.gc.handle_of(make_tree(h, depth - 1));
+		gclib::handle<node> right = h.gc.handle_of(make_tree(h, depth - 1));
+		node *out = h.make<node>(); // the allocation may move left and right
+		out->left = left.get();
+		out->right = right.get();
+		return out;
+	}
+	void populate(malloc_heap &h, int depth, node *n) {
+		if (depth <= 0) {
+			return;
+		}
+		n->left = h.make<node>();
+		n->right = h.make<node>();
+		populate(h, depth - 1, n->left);
+		populate(h, depth - 1, n->right);
+	}
+	node *make_tree(malloc_heap &h, int depth) {
+		if (depth <= 0) {
+			return h.make<node>();
+		}
+		node *out = h.make<node>();
+		out->left = make_tree(h, depth - 1);
+		out->right = make_tree(h, depth - 1);
+		return out;
+	}
+	void free_tree(node *n) {
+		if (n) {
+			free_tree(n->left);
+			free_tree(n->right);
+			delete n;
+		}
+	}
+	constexpr int tree_size(int depth) { return (1 << (depth + 1)) - 1; }
+
+	void gcbench(gc_heap &h, int max_depth) {
+		gclib::handle_scope scope(h.gc);
+		make_tree(h, max_depth + 2); // stretch the heap
+		gclib::handle<node> long_lived = h.gc.handle_of(h.make<node>());
+		populate(h, max_depth, long_lived);
+		uvec array(&h.gc);
+		h.gc.add_root(array.data_ref());
+		array.reserve(500'000);
+		for (int depth = 4; depth <= max_depth; depth += 2) {
+			const int iterations = 2 * tree_size(max_depth + 2) / tree_size(depth);
+			for (int i = 0; i < iterations; i++) {
+				gclib::handle<node> top_down = h.gc.handle_of(h.make<node>());
+				populate(h, depth, top_down);
+				make_tree(h, depth);
+				top_down.set(nullptr);
+			}
+		}
+		h.gc.remove_root(array.data_ref());
+	}
+	void gcbench(malloc_heap &h, int max_depth) {
+		free_tree(make_tree(h, max_depth + 2));
+		node *long_lived = h.make<node>();
+		populate(h, max_depth, long_lived);
+		std::vector<uint64_t> array;
+		array.reserve(500'000);
+		for (int depth = 4; depth <= max_depth; depth += 2) {
+			const int iterations = 2 * tree_size(max_depth + 2) / tree_size(depth);
+			for (int i = 0; i < iterations; i++) {
+				node *top_down = h.make<node>();
+				populate(h, depth, top_down);
+				free_tree(top_down);
+				free_tree(make_tree(h, depth));
+			}
+		}
+		free_tree(long_lived);
+	}
+
+	// a long lived linked list, while short lived ones are built and dropped
+
+	constexpr int long_list_length = 200'000;
+	constexpr int short_list_length = 1'000;
+
+	link *build_list(gc_heap &h, int length) {
+		gclib::handle_scope scope(h.gc);
+		gclib::handle<link> head = h.gc.handle_of<link>(nullptr);
+		for (int i = 0; i < length; i++) {
+			link *l = h.make<link>();
+			l->data = i;
+			l->next = head.get();
+			head.set(l);
+		}
+		return head.get();
+	}
+	link *build_list(malloc_heap &h, int length) {
+		link *head = nullptr;
+		for (int i = 0; i < length; i++) {
+			link *l = h.make<link>();
+			l->data = i;
+			l->next = head;
+			head = l;
+		}
+		return head;
+	}
+	void free_list(link *l) {
+		while (l) {
+			link *next = l->next;
+			delete l;
+			l = next;
+		}
+	}
+
+	void lists(gc_heap &h, int rounds) {
+		gclib::handle_scope scope(h.gc);
+		h.gc.handle_of(build_list(h, long_list_length)); // kept until the scope ends
+		for (int i = 0; i < rounds * 2'000; i++) {
+			build_list(h, short_list_length);
+		}
+	}
+	void lists(malloc_heap &h, int rounds) {
+		link *kept = build_list(h, long_list_length);
+		for (int i = 0; i < rounds * 2'000; i++) {
+			free_list(build_list(h, short_list_length));
+		}
+		free_list(kept);
+	}
+
+	// vectors growing from empty, one element at a time
+
+	void vectors(gc_heap &h, int rounds) {
+		for (int i = 0; i < rounds * 40; i++) {
+			uvec v(&h.gc);
+			h.gc.add_root(v.data_ref());
+			for (uint64_t j = 0; j < 100'000; j++) {
+				v.push_back(j);
+				h.out.ops++;
+				h.poll();
+			}
+			h.gc.remove_root(v.data_ref());
+		}
+	}
+	void vectors(malloc_heap &h, int rounds) {
+		for (int i = 0; i < rounds * 40; i++) {
+			std::vector<uint64_t> v;
+			for (uint64_t j = 0; j < 100'000; j++) {
+				v.push_back(j);
+				h.out.ops++;
+			}
+		}
+	}
+
+	// a random graph, with edges rewired and nodes replaced by new ones
+
+	constexpr size_t graph_nodes = 100'000;
+
+	void graph(gc_heap &h, int rounds) {
+		gclib::handle_scope scope(h.gc);
+		std::mt19937_64 rng(11);
+		std::vector<gclib::handle<graph_node>> table;
+		for (size_t i = 0; i < graph_nodes; i++) {
+			table.push_back(h.gc.handle_of(h.make<graph_node>()));
+		}
+		for (int i = 0; i < rounds * 2'000'000; i++) {
+			const uint64_t r = rng();
+			if (r % 4 == 0) {
+				graph_node *n = h.make<graph_node>();
+				for (graph_node *&edge : n->edges) {
+					edge = table[rng() % graph_nodes].get();
+				}
+				table[(r >> 8) % graph_nodes].set(n);
+			} else {
+				table[(r >> 8) % graph_nodes]->edges[r % graph_degree] = table[rng() % graph_nodes].get();
+				h.out.ops++;
+			}
+		}
+	}
+	/// edges are only written, so replaced nodes can be freed right away
+	void graph(malloc_heap &h, int rounds) {
+		std::mt19937_64 rng(11);
+		std::vector<graph_node *> table;
+		for (size_t i = 0; i < graph_nodes; i++) {
+			table.push_back(h.make<graph_node>());
+		}
+		for (int i = 0; i < rounds * 2'000'000; i++) {
+			const uint64_t r = rng();
+			if (r % 4 == 0) {
+				graph_node *n = h.make<graph_node>();
+				for (graph_node *&edge : n->edges) {
+					edge = table[rng() % graph_nodes];
+				}
+				delete table[(r >> 8) % graph_nodes];
+				table[(r >> 8) % graph_nodes] = n;
+			} else {
+				table[(r >> 8) % graph_nodes]->edges[r % graph_degree] = table[rng() % graph_nodes];
+				h.out.ops++;
+			}
+		}
+		for (graph_node *n : table) {
+			delete n;
+		}
+	}
+
+	template<typename Heap, typename Workload>
+	result run(const char *workload_name, Workload &&workload) {
+		result out;
+		out.workload = workload_name;
+		out.heap = Heap::name;
+		reset_peak_rss();
+		{
+			Heap h(out);
+			const auto start = std::chrono::steady_clock::now();
+			workload(h);
+			out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			h.finish();
+		}
+		out.peak_rss_kib = peak_rss_kib();
+		return out;
+	}
+	double percentile(const std::vector<double> &sorted, double q) {
+		if (sorted.empty()) {
+			return 0;
+		}
+		return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()))];
+	}
+}
+
+int main(int argc, char **argv) {
+	bool json = false;
+	int scale = 1;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--json") == 0) {
+			json = true;
+		} else {
+			scale = std::max(1, std::atoi(argv[i]));
+		}
+	}
+	const int tree_depth = 14 + std::min(scale, 3);
+	std::vector<result> results;
+	const auto both = [&](const char *name, auto &&workload) {
+		results.push_back(run<gc_heap>(name, workload));
+		results.push_back(run<malloc_heap>(name, workload));
+	};
+	both("gcbench", [&](auto &h) { gcbench(h, tree_depth); });
+	both("lists", [&](auto &h) { lists(h, scale); });
+	both("vectors", [&](auto &h) { vectors(h, scale); });
+	both("graph", [&](auto &h) { graph(h, scale); });
+
+	if (json) {
+		std::printf("[\n");
+		for (size_t i = 0; i < results.size(); i++) {
+			result &r = results[i];
+			std::sort(r.pauses_ms.begin(), r.pauses_ms.end());
+			std::printf("\t{\"workload\": \"%s\", \"heap\": \"%s\", \"ops\": %llu, \"seconds\": %.6f, \"ops_per_second\": %.1f, "
+				"\"pauses\": %zu, \"pause_p50_ms\": %.4f, \"pause_p99_ms\": %.4f, \"pause_max_ms\": %.4f, "
+				"\"collections\": %llu, \"peak_blocks\": %llu, \"peak_rss_kib\": %llu}%s\n",
+				r.workload, r.heap, static_cast<unsigned long long>(r.ops), r.seconds, r.ops / r.seconds,
+				r.pauses_ms.size(), percentile(r.pauses_ms, 0.5), percentile(r.pauses_ms, 0.99),
+				r.pauses_ms.empty() ? 0.0 : r.pauses_ms.back(),
+				static_cast<unsigned long long>(r.collections), static_cast<unsigned long long>(r.peak_blocks),
+				static_cast<unsigned long long>(r.peak_rss_kib), i + 1 < results.size() ? "," : "");
+		}
+		std::printf("]\n");
+		return 0;
+	}
+	std::printf("%-8s %-7s %12s %9s %9s %9s %9s %8s %10s\n", "workload", "heap", "Mops/s", "pauses",
+		"p50 ms", "p99 ms", "max ms", "blocks", "RSS MiB");
+	for (result &r : results) {
+		std::sort(r.pauses_ms.begin(), r.pauses_ms.end());
+		std::printf("%-8s %-7s %12.2f %9zu %9.3f %9.3f %9.3f %8llu %10.1f\n", r.workload, r.heap,
+			r.ops / r.seconds / 1e6, r.pauses_ms.size(), percentile(r.pauses_ms, 0.5), percentile(r.pauses_ms, 0.99),
+			r.pauses_ms.empty() ? 0.0 : r.pauses_ms.back(), static_cast<unsigned long long>(r.peak_blocks),
+			r.peak_rss_kib / 1024.0);
+	}
+}
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <gclib/gc.hpp>
+#include <gclib/util.hpp>
+
+// push_back heavy workloads: vectors built one at a time grow in place at the end of the bump range,
+// two vectors built in turns never end there and have to be copied on every growth, and one huge
+// vector with all the elements grows by remapping its pages once it's a big object
+
+namespace {
+	enum tag : uint8_t { tag_vec, tag_vec_data };
+	constexpr size_t vec_data_header = gclib::make_header(tag_vec_data);
+	struct gcvec {
+		tag t;
+		gclib::vector<uint64_t, vec_data_header, gclib::void_gc> data;
+		gcvec(gclib::void_gc *gc) : t(tag_vec), data(gc) { }
+	};
+	size_t bytes_of(void *obj) {
+		return *(tag *)obj == tag_vec ? sizeof(gcvec) : gclib::bytes_vec_data<uint64_t>(obj);
+	}
+	std::optional<void **> ref_begin(void *obj) {
+		if (*(tag *)obj == tag_vec_data) {
+			return std::nullopt;
+		}
+		return ((gcvec *)obj)->data.data_ref();
+	}
+	std::optional<void **> ref_next(void *, void **) { return std::nullopt; }
+
+	struct pause_totals : gclib::gc_listener {
+		uint64_t collections = 0;
+		std::chrono::steady_clock::duration pause{};
+		void collection_end(const gclib::collection_stats &stats) override {
+			collections++;
+			pause += stats.pause;
+		}
+	};
+	struct result {
+		double ns_per_push;
+		uint64_t collections;
+		double gc_ms;
+	};
+	template<typename Fun>
+	result measure(pause_totals &totals, size_t pushes, Fun &&fun) {
+		totals = pause_totals();
+		const auto start = std::chrono::steady_clock::now();
+		fun();
+		const auto time = std::chrono::steady_clock::now() - start;
+		return {
+			std::chrono::duration<double, std::nano>(time).count() / pushes,
+			totals.collections,
+			std::chrono::duration<double, std::milli>(totals.pause).count()
+		};
+	}
+}
+
+int main(int argc, char **argv) {
+	const size_t vectors = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20'000;
+	const size_t length = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 500;
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	pause_totals totals;
+	gc.set_listener(&totals);
+	uint64_t sum = 0;
+	const result alone = measure(totals, vectors * length, [&]() {
+		for (size_t i = 0; i < vectors; i++) {
+			gclib::handle_scope scope(gc);
+			gclib::handle<gcvec> v = gc.make_handle<gcvec>(&gc);
+			for (size_t j = 0; j < length; j++) {
+				v->data.push_back(j);
+			}
+			sum += v->data[length - 1];
+		}
+	});
+	const result interleaved = measure(totals, vectors * length, [&]() {
+		for (size_t i = 0; i < vectors; i += 2) {
+			gclib::handle_scope scope(gc);
+			gclib::handle<gcvec> a = gc.make_handle<gcvec>(&gc);
+			gclib::handle<gcvec> b = gc.make_handle<gcvec>(&gc);
+			for (size_t j = 0; j < length; j++) {
+				a->data.push_back(j);
+				b->data.push_back(j);
+			}
+			sum += a->data[length - 1] + b->data[length - 1];
+		}
+	});
+	const result huge = measure(totals, vectors * length, [&]() {
+		gclib::handle_scope scope(gc);
+		gclib::handle<gcvec> v = gc.make_handle<gcvec>(&gc);
+		for (size_t j = 0; j < vectors * length; j++) {
+			v->data.push_back(j);
+		}
+		sum += v->data[length - 1];
+	});
+	const auto std_start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < vectors; i++) {
+		std::vector<uint64_t> v;
+		for (size_t j = 0; j < length; j++) {
+			v.push_back(j);
+		}
+		sum += v[length - 1];
+	}
+	const double std_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - std_start).count() / (vectors * length);
+	std::printf("%zu vectors of %zu elements (checksum %llu)\n", vectors, length, static_cast<unsigned long long>(sum));
+	std::printf("%14s %12s %12s %12s\n", "", "ns/push", "collections", "pauses ms");
+	std::printf("%14s %12.2f %12llu %12.2f\n", "in place", alone.ns_per_push, static_cast<unsigned long long>(alone.collections), alone.gc_ms);
+	std::printf("%14s %12.2f %12llu %12.2f\n", "interleaved", interleaved.ns_per_push, static_cast<unsigned long long>(interleaved.collections), interleaved.gc_ms);
+	std::printf("%14s %12.2f %12llu %12.2f\n", "one huge", huge.ns_per_push, static_cast<unsigned long long>(huge.collections), huge.gc_ms);
+	std::printf("%14s %12.2f\n", "std::vector", std_ns);
+}
@@ -2,6 +2,8 @@
 #define GCLIB_BLOCK_HPP_
 #include <cstddef>
 #include <cstdint>
+#include <atomic>
+#include <bit>
 #include "params.hpp"
 
 namespace gclib {
@@ -9,22 +11,218 @@ namespace gclib {
 	inline constexpr size_t bytes_to_maxalings(size_t bytes) {
 		return (bytes + max_align-1) / max_align;
 	}
-	struct block {
-		uint64_t free[line_groups];
+	/// block::flag of blocks which aren't evacuation candidates, candidates have their index there
+	constexpr uint64_t not_evacuated = 0xffffffffffffffffull;
+	/// returns block_bytes of memory aligned to block_bytes (a power of two), from a pool shared by all gcs
+	void *alloc_block_memory(size_t block_bytes);
+	void free_block_memory(void *memory, size_t block_bytes);
+
+	template<typename Geometry>
+	struct basic_block {
+		static constexpr size_t line_size = Geometry::line_size;
+		static constexpr size_t block_size = Geometry::block_size;
+		static constexpr size_t line_groups = Geometry::line_groups;
+		static constexpr size_t block_granules = block_size / max_align;
+		static_assert(max_align <= line_size);
+		static_assert(block_granules % 64 == 0);
+		static constexpr size_t mark_groups = block_granules / 64;
+		static constexpr size_t line_granules = line_size / max_align;
+		static_assert(64 % line_granules == 0);
+
+		uint64_t free[line_groups]; // allocation map, rebuilt from lines in prepare()
+		uint64_t lines[line_groups]; // live line marks, set by add_object
+		uint64_t cards[line_groups]; // lines holding old objects which were written to since the last collection
+		uint64_t marks[mark_groups]; // one bit per max_align granule, set at the first granule of a marked object
 		uint64_t next_free;
 		uint64_t flag;
-		//uint64_t used_space;
-		void clear();
-		void prepare();
-		bool is_full() const;
-		void next_range(void **begin, void **end);
-		void add_object(void *at, size_t bytes);
-		size_t count_holes() const;
+		basic_block *next_recycled; // link in the list of blocks with free lines of a shared heap
+		uint64_t live_bytes; // of the objects marked since clear(), block_size for blocks which weren't marked yet
+		/// clears mark bits and line marks
+		inline void clear() {
+			for (size_t i = 0; i < line_groups; i++) {
+				lines[i] = i < metadata_lines / 64 ? 0xffffffffffffffffull : 0;
+			}
+			if constexpr (metadata_lines % 64) {
+				lines[metadata_lines / 64] = ~(0xffffffffffffffffull << (metadata_lines % 64));
+			}
+			for (size_t i = 0; i < mark_groups; i++) {
+				marks[i] = 0;
+			}
+			live_bytes = 0;
+		}
+		/// rebuilds the allocation map from line marks
+		inline void prepare() {
+			for (size_t i = 0; i < line_groups; i++) {
+				free[i] = ~lines[i];
+			}
+			next_free = 0;
+			while (next_free < line_groups && !free[next_free]) { next_free++; }
+		}
+		inline bool is_full() const {
+			return next_free == line_groups;
+		}
+		inline void next_range(void **begin, void **end) {
+			const size_t offset = std::countr_zero(free[next_free]);
+			*begin = reinterpret_cast<uint8_t *>(this) + (64*next_free + offset) * line_size;
+			uint64_t free_end = free[next_free] + (1ull << offset);
+			if (free_end == 0) { // overflow into next line group
+				do {
+					free[next_free++] = 0;
+				} while (next_free < line_groups && free[next_free] == 0xffffffffffffffffull);
+				if (next_free == line_groups) { // rest of the block is free
+					*end = reinterpret_cast<uint8_t *>(this) + block_size;
+					return;
+				}
+				free_end = free[next_free] + 1;
+			}
+			const size_t offset_end = std::countr_zero(free_end);
+			*end = reinterpret_cast<uint8_t *>(this) + (64*next_free + offset_end) * line_size;
+			free[next_free] = free_end & (free_end - 1);
+			while (next_free < line_groups && !free[next_free]) { next_free++; }
+		}
+		inline void add_object(void *at, size_t bytes) {
+			live_bytes += bytes;
+			mark_lines<false>(at, bytes);
+		}
+		/// add_object which can run concurrently with other add_object_atomic calls on the same block
+		inline void add_object_atomic(void *at, size_t bytes) {
+			std::atomic_ref<uint64_t>(live_bytes).fetch_add(bytes, std::memory_order_relaxed);
+			mark_lines<true>(at, bytes);
+		}
+		inline size_t count_holes() const {
+			size_t holes = 0;
+			for (size_t i = 0; i < line_groups; i++) {
+				holes += std::popcount(lines[i] & ~(lines[i] >> 1));
+				if (i && (lines[i-1] >> 63) == 1 && (lines[i] & 1) == 0) {
+					holes++;
+				}
+			}
+			return holes;
+		}
+		/// returns true if the object was already marked
+		inline bool mark(void *obj) {
+			const size_t granule = granule_of(obj);
+			const uint64_t bit = 1ull << (granule % 64);
+			const bool was_marked = marks[granule / 64] & bit;
+			marks[granule / 64] |= bit;
+			return was_marked;
+		}
+		/// mark which can run concurrently with other mark_atomic calls on the same block
+		inline bool mark_atomic(void *obj) {
+			const size_t granule = granule_of(obj);
+			const uint64_t bit = 1ull << (granule % 64);
+			return std::atomic_ref<uint64_t>(marks[granule / 64]).fetch_or(bit, std::memory_order_relaxed) & bit;
+		}
+		inline bool is_marked(void *obj) const {
+			const size_t granule = granule_of(obj);
+			return marks[granule / 64] & (1ull << (granule % 64));
+		}
+		template<typename Fun>
+		inline void for_each_marked(Fun &&fun) {
+			for (size_t i = 0; i < mark_groups; i++) {
+				for (uint64_t group = marks[i]; group; group &= group - 1) {
+					fun(reinterpret_cast<uint8_t *>(this) + (64*i + std::countr_zero(group)) * max_align);
+				}
+			}
+		}
+		inline void dirty_card(void *obj) {
+			const size_t line = line_of(obj);
+			cards[line / 64] |= 1ull << (line % 64);
+		}
+		inline bool is_card_dirty(void *obj) const {
+			const size_t line = line_of(obj);
+			return cards[line / 64] & (1ull << (line % 64));
+		}
+		inline bool has_dirty_cards() const {
+			for (size_t i = 0; i < line_groups; i++) {
+				if (cards[i]) {
+					return true;
+				}
+			}
+			return false;
+		}
+		inline void clear_cards() {
+			for (size_t i = 0; i < line_groups; i++) {
+				cards[i] = 0;
+			}
+		}
+		/// calls fun for every marked object starting in a dirty line
+		template<typename Fun>
+		inline void for_each_marked_in_dirty_cards(Fun &&fun) {
+			constexpr uint64_t line_mask = line_granules == 64 ? 0xffffffffffffffffull : (1ull << line_granules) - 1;
+			for (size_t i = 0; i < line_groups; i++) {
+				for (uint64_t group = cards[i]; group; group &= group - 1) {
+					const size_t first_granule = (64*i + std::countr_zero(group)) * line_granules;
+					uint64_t line_marks = (marks[first_granule / 64] >> (first_granule % 64)) & line_mask;
+					for (; line_marks; line_marks &= line_marks - 1) {
+						fun(reinterpret_cast<uint8_t *>(this) + (first_granule + std::countr_zero(line_marks)) * max_align);
+					}
+				}
+			}
+		}
+		inline size_t granule_of(const void *obj) const {
+			return (reinterpret_cast<const uint8_t *>(obj) - reinterpret_cast<const uint8_t *>(this)) / max_align;
+		}
+	private:
+		static constexpr size_t metadata_lines = ((3*line_groups + mark_groups + 4) * sizeof(uint64_t) + line_size - 1) / line_size;
+
+		inline size_t line_of(const void *obj) const {
+			return (reinterpret_cast<const uint8_t *>(obj) - reinterpret_cast<const uint8_t *>(this)) / line_size;
+		}
+		template<bool Atomic>
+		static inline void set_line_bits(uint64_t &group, uint64_t bits) {
+			if constexpr (Atomic) {
+				std::atomic_ref<uint64_t>(group).fetch_or(bits, std::memory_order_relaxed);
+			} else {
+				group |= bits;
+			}
+		}
+		template<bool Atomic>
+		inline void mark_lines(void *at, size_t bytes) {
+			const size_t first_line = line_of(at);
+			const size_t last_line = line_of(reinterpret_cast<uint8_t *>(at) + bytes - 1);
+			const size_t first_line_group = first_line / 64;
+			const size_t last_line_group = last_line / 64;
+			const size_t first_line_group_part = first_line % 64;
+			const size_t last_line_group_part = last_line % 64;
+			for (size_t i = first_line_group + 1; i < last_line_group; i++) {
+				set_line_bits<Atomic>(lines[i], 0xffffffffffffffffull);
+			}
+			if (first_line_group == last_line_group) {
+				uint64_t mask = first_line_group_part == 0 ? 0 :
+					0xffffffffffffffffull >> (64 - first_line_group_part);
+				mask |= last_line_group_part == 63 ? 0 :
+					0xffffffffffffffffull << (last_line_group_part + 1);
+				set_line_bits<Atomic>(lines[first_line_group], ~mask);
+			} else {
+				set_line_bits<Atomic>(lines[first_line_group], ~(first_line_group_part == 0 ? 0 :
+					0xffffffffffffffffull >> (64 - first_line_group_part)));
+				set_line_bits<Atomic>(lines[last_line_group], ~(last_line_group_part == 63 ? 0 :
+					0xffffffffffffffffull << (last_line_group_part + 1)));
+			}
+		}
 	};
-	block *alloc_block();
-	void free_block(block *b);
-	block *obj_block(void *obj);
+	using block = basic_block<default_geometry>;
+
+	template<typename Geometry = default_geometry>
+	inline basic_block<Geometry> *alloc_block() {
+		static_assert(sizeof(basic_block<Geometry>) == (3*Geometry::line_groups + basic_block<Geometry>::mark_groups + 4) * sizeof(uint64_t));
+		basic_block<Geometry> *out = static_cast<basic_block<Geometry> *>(alloc_block_memory(Geometry::block_size));
+		out->clear();
+		out->clear_cards();
+		out->prepare();
+		out->flag = not_evacuated;
+		out->live_bytes = Geometry::block_size; // its objects weren't marked yet, it counts as full until they are
+		return out;
+	}
+	template<typename Geometry>
+	inline void free_block(basic_block<Geometry> *b) {
+		free_block_memory(b, Geometry::block_size);
+	}
+	template<typename Geometry = default_geometry>
+	inline basic_block<Geometry> *obj_block(void *obj) {
+		return reinterpret_cast<basic_block<Geometry> *>(reinterpret_cast<std::uintptr_t>(obj) & ~(Geometry::block_size - 1));
+	}
 }
 
 #endif
-
@@ -0,0 +1,30 @@
+#ifndef GCLIB_CONFIG_HPP_
+#define GCLIB_CONFIG_HPP_
+#include <cstddef>
+
+namespace gclib {
+	/// collection policy of a gc, can be changed at any time with set_config()
+	struct gc_config {
+		/// after a collection, the heap may grow to heap_growth times the live bytes before the next one
+		double heap_growth = 2.0;
+		/// no collections are triggered below this heap size
+		size_t min_heap_bytes = 4 * 1024 * 1024;
+		/// collections are triggered before the heap grows above this, 0 means no limit - a soft limit, the heap still grows if the live data doesn't fit
+		size_t max_heap_bytes = 0;
+		/**
+		 * target share of time spent collecting (0 to 1), if collections take more than that, the heap grows
+		 * further between them (up to max_pacing_stretch times) - 0 turns it off
+		 */
+		double gc_cpu_share = 0;
+		/// full collections evacuate at most one in compact_ratio blocks (the ones with the least live data)
+		size_t compact_ratio = 20;
+		/// blocks with more than this share of their bytes live aren't evacuated, copying them costs more than it frees
+		double max_evacuation_live_ratio = 0.5;
+		/// full collections evacuate blocks with at most this many live bytes in total, 0 means no limit
+		size_t evacuation_budget_bytes = 4 * 1024 * 1024;
+		/// in generational mode, every minor_collections_per_major+1-th collection triggered by alloc() is a full one
+		size_t minor_collections_per_major = 8;
+	};
+}
+
+#endif
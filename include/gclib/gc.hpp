@@ -1,24 +1,38 @@
 #ifndef GCLIB_GC_HPP_
 #define GCLIB_GC_HPP_
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
 #include <functional>
+#include <mutex>
+#include <thread>
 #include <optional>
-#include <stack>
-#include <unordered_set>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "block.hpp"
+#include "config.hpp"
+#include "handles.hpp"
+#include "large.hpp"
+#include "mark_stack.hpp"
+#include "parallel.hpp"
+#include "policy.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
 
 namespace gclib {
-	template<typename ObjSizeFun, typename PointerBeginFun, typename NextPointerFun> class gc;
-	template<typename T, typename ObjSizeFun, typename PointerBeginFun, typename NextPointerFun>
+	template<trace_policy Policy, typename Geometry> class basic_gc;
+	template<typename T, typename Policy, typename Geometry = default_geometry>
 	class unique_root {
 	public:
 		using element_type = T;
-		using gc_type = gc<ObjSizeFun, PointerBeginFun, NextPointerFun>;
-		using self_type = unique_root<T, ObjSizeFun, PointerBeginFun, NextPointerFun>;
+		using gc_type = basic_gc<Policy, Geometry>;
+		using self_type = unique_root<T, Policy, Geometry>;
 		unique_root(const self_type &) = delete;
 		constexpr inline unique_root(void *_data, gc_type *g) noexcept : data(reinterpret_cast<T *>(_data)), gc(g) {
 			gc->add_root(reinterpret_cast<void **>(&data));
@@ -46,164 +60,698 @@ namespace gclib {
 		constexpr inline T *operator->() noexcept { return data; }
 		template<typename R> constexpr inline R *as() noexcept { return reinterpret_cast<R *>(data); }
 	private:
-		friend class gc<ObjSizeFun, PointerBeginFun, NextPointerFun>;
+		friend class basic_gc<Policy, Geometry>;
 		T *data;
 		gc_type *gc;
 	};
-	template<typename ObjSizeFun, typename PointerBeginFun, typename NextPointerFun>
-	class gc {
+	/**
+	 * reference which doesn't keep the object alive, the collector sets it to nullptr once the object dies
+	 *
+	 * Like unique_root, it lives outside of the gc heap. Read it with get() - during concurrent and incremental
+	 * marking that keeps the object alive until the collection ends.
+	 */
+	template<typename T, typename Policy, typename Geometry = default_geometry>
+	class weak_ref {
+	public:
+		using element_type = T;
+		using gc_type = basic_gc<Policy, Geometry>;
+		using self_type = weak_ref<T, Policy, Geometry>;
+		weak_ref(const self_type &) = delete;
+		inline weak_ref(T *_data, gc_type *g) : data(_data), gc(g) {
+			gc->add_weak(reinterpret_cast<void **>(&data));
+		}
+		inline weak_ref(self_type &&o) : data(o.data), gc(o.gc) {
+			gc->add_weak(reinterpret_cast<void **>(&data));
+		}
+		inline self_type &operator=(self_type &&o) {
+			reset(o.get());
+			return *this;
+		}
+		inline ~weak_ref() { gc->remove_weak(reinterpret_cast<void **>(&data)); }
+		inline T *get() {
+			gc->keep_alive(data);
+			return data;
+		}
+		inline void reset(T *obj) { data = obj; }
+		inline bool expired() const { return data == nullptr; }
+	private:
+		T *data;
+		gc_type *gc;
+	};
+	/**
+	 * weak map from objects to objects, a value is kept alive only while its key is
+	 *
+	 * Entries whose keys die are removed by the collector, the values of live keys are traced (even if
+	 * they refer back to the key). Lives outside of the gc heap and may only be used by one thread at a time.
+	 */
+	template<typename K, typename V, typename Policy, typename Geometry = default_geometry>
+	class ephemeron_map {
+	public:
+		using gc_type = basic_gc<Policy, Geometry>;
+		inline explicit ephemeron_map(gc_type *g) : gc(g) { gc->add_ephemerons(&entries); }
+		ephemeron_map(const ephemeron_map &) = delete;
+		inline ~ephemeron_map() { gc->remove_ephemerons(&entries); }
+		inline void set(K *key, V *value) {
+			gc->keep_alive(value);
+			entries[key] = value;
+		}
+		/// nullptr if key isn't in the map
+		inline V *get(K *key) {
+			const auto it = entries.find(key);
+			if (it == entries.end()) {
+				return nullptr;
+			}
+			gc->keep_alive(it->second);
+			return reinterpret_cast<V *>(it->second);
+		}
+		inline bool contains(K *key) const { return entries.contains(key); }
+		inline void erase(K *key) { entries.erase(key); }
+		inline void clear() { entries.clear(); }
+		inline size_t size() const { return entries.size(); }
+	private:
+		std::unordered_map<void *, void *> entries;
+		gc_type *gc;
+	};
+	/**
+	 * a table of weak references with its own layout (like string_interner), registered with
+	 * basic_gc::add_weak_table
+	 *
+	 * After marking, each collection calls sweep() with a function which returns where an object is now,
+	 * or nullptr if it died. The table has to drop or update all its references to objects.
+	 */
+	class weak_table {
 	public:
+		using live_fun = void *(*)(void *context, void *obj);
+		virtual ~weak_table() = default;
+		virtual void sweep(live_fun live, void *context) = 0;
+	};
+	/**
+	 * the collector, Policy tells it the sizes of objects and where their references are (see trace_policy),
+	 * Geometry sets the sizes of lines and blocks (see heap_geometry)
+	 *
+	 * The constructor arguments are passed on to the policy.
+	 */
+	template<trace_policy Policy, typename Geometry = default_geometry>
+	class basic_gc {
+	public:
+		using policy_type = Policy;
+		using geometry_type = Geometry;
+		using block_type = basic_block<Geometry>;
+		template<typename T>
+		using unique_root_type = unique_root<T, Policy, Geometry>;
 		template<typename T>
-		using unique_root_type = unique_root<T, ObjSizeFun, PointerBeginFun, NextPointerFun>;
+		using weak_ref_type = weak_ref<T, Policy, Geometry>;
+		template<typename K, typename V>
+		using ephemeron_map_type = ephemeron_map<K, V, Policy, Geometry>;
 
-		inline gc(ObjSizeFun obj_size_fun, PointerBeginFun pointer_begin_fun, NextPointerFun next_pointer_fun) :
-			size_fun(obj_size_fun), begin_fun(pointer_begin_fun), next_fun(next_pointer_fun) {
+		template<typename ...Ts> requires std::constructible_from<Policy, Ts...>
+		inline explicit basic_gc(Ts &&...policy_args) : policy(std::forward<Ts>(policy_args)...) {
 			bump_end = bump = nullptr;
-			collet_counter = block_collect_factor;
-			object_count = 0;
+			sweep_cursor = sweep_limit = 0;
+			allocated_bytes = 0;
+			allocation_budget = conf.min_heap_bytes;
+			old_marked_bytes = marked_bytes = concurrent_marked_bytes = 0;
+			pause_depth = 0;
+			gc_time = std::chrono::steady_clock::duration::zero();
+			last_collection_end = std::chrono::steady_clock::now();
+			last_pause_time = std::chrono::steady_clock::duration::zero();
+			pauses = 0;
+			listener = nullptr;
+			stats_ending = false;
+			old_object_count = object_count = 0;
+			minor_collections = major_collections = 0;
+			minor_since_major = 0;
+			generational = minor_allowed = false;
+			marking_active = concurrent = false;
+			concurrent_marked = 0;
+			evacuating = false;
+			pinned = nullptr;
+			shared = false;
+			safepoint_requested.store(false, std::memory_order_relaxed);
+			parked = 0;
+			collection_epoch = 0;
+			recycled_blocks.store(nullptr, std::memory_order_relaxed);
+			id = new_id();
 		}
-		gc(const gc &) = delete;
-		inline ~gc() {
-			for (block *b : blocks) {
-				free_block(b);
+		basic_gc(const basic_gc &) = delete;
+		inline ~basic_gc() {
+			if (marker_thread.joinable()) {
+				marker_thread.join();
 			}
-			for (void *b : big_objects) {
-				std::free(b);
+			for (block_type *b : blocks) {
+				free_block(b);
 			}
 		}
 		inline void *alloc(size_t bytes) {
-			if (!--collet_counter) {
-				collet_counter = block_collect_factor * blocks.size();
-				collect();
+			bytes = bytes_to_maxalings(bytes)*max_align;
+			if (shared) {
+				[[unlikely]];
+				return alloc_shared(bytes);
+			}
+			allocated_bytes += bytes;
+			if (allocated_bytes >= allocation_budget) {
+				[[unlikely]];
+				if (marking_active) {
+					finish_concurrent_collect();
+				} else if (generational && minor_since_major < conf.minor_collections_per_major) {
+					collect_minor();
+				} else if (concurrent) {
+					start_concurrent_collect();
+				} else {
+					collect();
+				}
+			} else if (marking_active && marker_done.load(std::memory_order_acquire)) {
+				[[unlikely]];
+				finish_concurrent_collect();
 			}
 			object_count++;
-			bytes = bytes_to_maxalings(bytes)*max_align;
-			static_assert(big_object_treshold <= block_size);
-			if (bytes <= big_object_treshold) {
+			void *out;
+			if (bytes <= Geometry::big_object_treshold) {
 				[[likely]];
-				void *res;
 				while (true) {
 					if (bump == nullptr) {
 						add_block();
-						return alloc_in_bump(bytes);
+						out = alloc_in_bump(bytes);
+						break;
 					}
-					res = alloc_in_bump(bytes);
-					if (res != nullptr)
+					out = alloc_in_bump(bytes);
+					if (out != nullptr)
 						break;
 					next_bump();
 				}
-				return res;
+				if (marking_active) { // allocate black
+					[[unlikely]];
+					block_type *b = obj_block<Geometry>(out);
+					b->mark_atomic(out);
+					b->add_object_atomic(out, bytes);
+					marked_bytes += bytes;
+				}
 			} else {
 				[[unlikely]];
-				void *out = std::malloc(bytes);
-				big_objects.push_back(out);
-				return out;
+				out = big_objects.alloc(bytes);
+				if (marking_active) {
+					big_object_header_of(out)->mark = 1;
+					marked_bytes += bytes;
+				}
 			}
+			return out;
 		}
+		/**
+		 * alloc() which doesn't move pin if it collects - for writing to a gc object (pin can point anywhere
+		 * into it) after allocating without a root to it, like gclib::vector does with its holder
+		 */
+		inline void *alloc_pinned(size_t bytes, void *pin) {
+			void *&slot = shared ? current_mutator().pinned : pinned;
+			slot = pin;
+			void *out = alloc(bytes);
+			slot = nullptr;
+			return out;
+		}
+		/**
+		 * grows obj (allocated with old_bytes) to new_bytes in place if it's the last allocation and the
+		 * free range it's in has room, returns false otherwise - then the caller has to allocate a new one
+		 *
+		 * It never collects, so nothing moves. The object has to report new_bytes as its size afterwards.
+		 */
+		inline bool try_extend(void *obj, size_t old_bytes, size_t new_bytes) {
+			old_bytes = bytes_to_maxalings(old_bytes)*max_align;
+			new_bytes = bytes_to_maxalings(new_bytes)*max_align;
+			if (new_bytes <= old_bytes) {
+				return new_bytes == old_bytes;
+			}
+			if (old_bytes > Geometry::big_object_treshold || new_bytes > Geometry::big_object_treshold) {
+				return false;
+			}
+			const size_t grow = new_bytes - old_bytes;
+			void *&end = shared ? current_mutator().bump : bump;
+			void *const limit = shared ? current_mutator().bump_end : bump_end;
+			if (end == nullptr || (uint8_t *)obj + old_bytes != end || static_cast<size_t>((uint8_t *)limit - (uint8_t *)end) < grow) {
+				return false;
+			}
+			if (!shared) {
+				if (allocated_bytes + grow >= allocation_budget) {
+					return false; // let alloc() collect
+				}
+				allocated_bytes += grow;
+			}
+			end = (uint8_t *)end + grow;
+			// a marked object (allocated black, or old with sticky marks) isn't marked again, so the lines
+			// of the grown part have to be marked here, its old part is already counted in live_bytes
+			uint8_t *const grown = (uint8_t *)obj + old_bytes;
+			if (marking_active) {
+				[[unlikely]];
+				obj_block<Geometry>(obj)->add_object_atomic(grown, grow);
+				marked_bytes += grow;
+			} else if (obj_block<Geometry>(obj)->is_marked(obj)) {
+				obj_block<Geometry>(obj)->add_object(grown, grow);
+			}
+			if (!shared && end == limit) {
+				next_bump();
+			}
+			return true;
+		}
+		/**
+		 * grows the big object obj to new_bytes without copying it (see large_object_space::resize),
+		 * returns its new address or nullptr if that isn't possible now - then the caller has to allocate
+		 * a new one
+		 *
+		 * obj may move, so the caller has to hold its only reference. Like try_extend(), it never collects.
+		 * It always fails while concurrent or incremental marking runs, the marker may be reading obj.
+		 */
+		inline void *try_resize_big(void *obj, size_t new_bytes) {
+			new_bytes = bytes_to_maxalings(new_bytes)*max_align;
+			if (marking_active || new_bytes <= Geometry::big_object_treshold || !is_big(obj)) {
+				return nullptr;
+			}
+			const size_t old_bytes = policy.size(obj);
+			if (new_bytes <= old_bytes) {
+				return obj;
+			}
+			std::unique_lock lock(blocks_mutex, std::defer_lock);
+			if (shared) {
+				lock.lock();
+			}
+			void *out = big_objects.resize(obj, new_bytes);
+			if (out == nullptr) {
+				return nullptr;
+			}
+			std::atomic_ref<uint64_t>(allocated_bytes).fetch_add(new_bytes - old_bytes, std::memory_order_relaxed);
+			if (out != obj && big_object_header_of(out)->remembered) {
+				*std::ranges::find(remembered_big_objects, obj) = out;
+			}
+			return out;
+		}
+		/// full collection, traces the whole heap from the roots (or finishes a running concurrent one)
 		inline void collect() {
-			for (block *b : blocks) {
-				b->clear();
+			if (marking_active) {
+				finish_concurrent_collect();
+				return;
 			}
-			std::unordered_set<void *> alive;
-			for (void **root : roots) {
-				mark(*root, alive);
+			if (shared && !stop_the_world()) {
+				return; // another thread collected meanwhile
+			}
+			{
+				pause_timer timer(*this);
+				begin_stats(collection_kind::full);
+				{
+					phase_timer phase(stats.phases.evacuation);
+					select_evacuation_candidates();
+				}
+				start_major_collection();
+				{
+					phase_timer phase(stats.phases.root_scan);
+					push_root_slots();
+				}
+				{
+					phase_timer phase(stats.phases.mark);
+					drain_mark_stack();
+					process_weak_refs();
+				}
+				finish_major_collection();
+			}
+			if (shared) {
+				resume_the_world();
+			}
+		}
+		/**
+		 * sticky mark bit collection, only traces objects allocated since the last collection
+		 *
+		 * Objects which survived a collection stay marked and are considered old, so they are neither traced
+		 * nor freed. References from old to young objects are found through the remembered set, which is
+		 * filled by write_barrier(), remember() and write_barrier_slot(). Falls back to collect() if generational mode is off
+		 * or there was no full collection since it was turned on.
+		 */
+		inline void collect_minor() {
+			if (!minor_allowed || marking_active || shared) {
+				collect();
+				return;
+			}
+			pause_timer timer(*this);
+			begin_stats(collection_kind::minor);
+			minor_collections++;
+			minor_since_major++;
+			object_count = old_object_count;
+			marked_bytes = old_marked_bytes;
+			{
+				phase_timer phase(stats.phases.root_scan);
+				push_root_slots();
+				for (block_type *b : remembered_blocks) {
+					b->for_each_marked_in_dirty_cards([this](void *o) { trace_refs(o); });
+					b->clear_cards();
+				}
+				for (void *big : remembered_big_objects) {
+					trace_refs(big);
+					big_object_header_of(big)->remembered = 0;
+				}
+				for (void **slot : remembered_slots) {
+					mark_stack.push(slot);
+				}
+				remembered_blocks.clear();
+				remembered_big_objects.clear();
+				remembered_slots.clear();
+			}
+			{
+				phase_timer phase(stats.phases.mark);
+				drain_mark_stack();
+				process_weak_refs();
+			}
+			{
+				phase_timer phase(stats.phases.big_sweep);
+				big_objects.sweep();
+			}
+			finish_collection();
+		}
+		/**
+		 * enables minor collections from alloc(), the mutator then has to call write_barrier() before storing
+		 * references into an object
+		 */
+		inline void set_generational(bool enabled) {
+			generational = enabled;
+			minor_allowed = false;
+		}
+		/**
+		 * starts a full collection which marks the heap on a background thread while the mutator runs
+		 *
+		 * Marking works on a snapshot of the heap from the moment it started: write_barrier() and
+		 * write_barrier_slot() record references before they're overwritten and objects allocated in the
+		 * meantime are marked right away. finish_concurrent_collect() then only marks what was recorded
+		 * and the current roots in a short pause. The callbacks run on the marking thread, concurrently
+		 * with the mutator changing the objects.
+		 */
+		inline void start_concurrent_collect() {
+			if (marking_active) {
+				return;
+			}
+			if (shared) {
+				collect();
+				return;
+			}
+			pause_timer timer(*this);
+			begin_stats(collection_kind::concurrent);
+			start_major_collection();
+			{
+				phase_timer phase(stats.phases.root_scan);
+				push_root_objects();
 			}
-			std::erase_if(big_objects, [&alive](void *big) {
-				if (alive.contains(big)) {
+			marking_active = true;
+			marker_done.store(false, std::memory_order_relaxed);
+			concurrent_stack.swap(mark_stack);
+			marker_thread = std::thread([this]() { concurrent_mark(); });
+		}
+		/**
+		 * waits for the background marking to finish and finishes the collection, does nothing if none is
+		 * running - also finishes incremental collections started by collect_step()
+		 */
+		inline void finish_concurrent_collect() {
+			if (!marking_active) {
+				return;
+			}
+			pause_timer timer(*this);
+			if (marker_thread.joinable()) {
+				marker_thread.join();
+			}
+			marking_active = false;
+			object_count += concurrent_marked;
+			marked_bytes += concurrent_marked_bytes;
+			concurrent_marked = concurrent_marked_bytes = 0;
+			{
+				phase_timer phase(stats.phases.root_scan);
+				push_root_slots();
+				mark_stack.append(satb_buffer);
+				mark_stack.append(satb_queue);
+			}
+			{
+				phase_timer phase(stats.phases.mark);
+				drain_mark_stack();
+				process_weak_refs();
+			}
+			finish_major_collection();
+		}
+		/**
+		 * does a slice of an incremental collection which takes about budget, returns true if it finished it
+		 *
+		 * The first call starts a full collection like start_concurrent_collect(), but the marking is done
+		 * by the following calls instead of a background thread, so the same write barriers are needed.
+		 * The last call marks the roots again and finishes the collection. Blocks are swept lazily by
+		 * alloc() afterwards. If alloc() wants to collect while the collection runs, it finishes it.
+		 */
+		inline bool collect_step(std::chrono::microseconds budget) {
+			if (shared) {
+				collect();
+				return true;
+			}
+			pause_timer timer(*this);
+			const auto deadline = std::chrono::steady_clock::now() + budget;
+			if (!marking_active) {
+				begin_stats(collection_kind::incremental);
+				start_major_collection();
+				phase_timer phase(stats.phases.root_scan);
+				push_root_objects();
+				marking_active = true;
+				marker_done.store(false, std::memory_order_relaxed);
+			} else if (marker_thread.joinable()) { // a concurrent collection is running
+				if (!marker_done.load(std::memory_order_acquire)) {
 					return false;
 				}
-				std::free(big);
+				finish_concurrent_collect();
 				return true;
-			});
-			if (blocks.size() > block_compact_ratio) {
-				std::vector<std::pair<size_t, size_t>> blocks_by_holes;
-				size_t blocks_with_holes_count = 0;
-				for (size_t i = 0; i < blocks.size(); i++) {
-					blocks_by_holes.push_back({blocks[i]->count_holes(), i});
-					blocks[i]->flag = 0xffffffffffffffffull;
-					if (blocks_by_holes.back().first > 1)
-						blocks_with_holes_count++;
-				}
-				std::ranges::sort(blocks_by_holes, std::greater<std::pair<size_t, size_t>>());
-				const size_t compact_count = std::min(blocks_by_holes.size() / block_compact_ratio, blocks_with_holes_count);
-				if (compact_count > 0) {
-					std::vector<size_t> to_compact(compact_count);
-					std::transform(blocks_by_holes.begin(), blocks_by_holes.begin() + to_compact.size(), to_compact.begin(), [](const auto &pair) { return pair.second; });
-					std::ranges::sort(to_compact, std::greater<size_t>());
-					std::vector<std::vector<void *>> to_compact_objs;
-					std::unordered_map<void *, std::vector<void **>> compacted_obj_outside_refs;
-					size_t j = 0;
-					for (size_t i : to_compact) {
-						blocks[i]->flag = j++;
-						to_compact_objs.emplace_back();
-					}
-					for (void *o : alive) {
-						block *b = obj_block(o);
-						if (b->flag != 0xffffffffffffffffull) {
-							to_compact_objs[b->flag].push_back(o);
-						} else {
-							for (auto it = begin_fun(o); it; it = next_fun(o, *it)) {
-								if (obj_block(**it)->flag != 0xffffffffffffffffull) {
-									compacted_obj_outside_refs[**it].push_back((void **)*it);
-								}
-							}
-						}
-					}
-					for (void **root : roots) {
-						if (obj_block(*root)->flag != 0xffffffffffffffffull) {
-							compacted_obj_outside_refs[*root].push_back(root);
-						}
-					}
-					std::unordered_map<void *, void *> transfer_map;
-					std::vector<block *> new_blocks;
-					void *c_bump = nullptr, *c_bump_end = nullptr;
-					new_blocks.push_back(alloc_block());
-					new_blocks.back()->next_range(&c_bump, &c_bump_end);
-					for (size_t i : to_compact) {
-						block *b = blocks[i];
-						for (void *o : to_compact_objs[b->flag]) {
-							size_t sz = bytes_to_maxalings(size_fun(o))*max_align;
-							if (static_cast<size_t>((uint8_t *)c_bump_end - (uint8_t *)c_bump) < sz) {
-								new_blocks.push_back(alloc_block());
-								new_blocks.back()->next_range(&c_bump, &c_bump_end);
-							}
-							transfer_map[o] = c_bump;
-							std::memcpy(c_bump, o, sz);
-							for (void **ref : compacted_obj_outside_refs[o]) {
-								*ref = c_bump;
-							}
-							c_bump = (uint8_t *)c_bump + sz;
-						}
+			}
+			while (true) {
+				if (mark_stack.empty()) {
+					mark_stack.append(satb_buffer);
+					mark_stack.append(satb_queue);
+					if (mark_stack.empty()) {
+						finish_concurrent_collect();
+						return true;
 					}
-					for (size_t i : to_compact) {
-						free_block(blocks[i]);
-						blocks.erase(blocks.begin() + i);
+				}
+				{
+					phase_timer phase(stats.phases.mark);
+					mark_some(incremental_mark_slice);
+				}
+				if (std::chrono::steady_clock::now() >= deadline) {
+					return false;
+				}
+			}
+		}
+		inline bool concurrent_collect_running() const { return marking_active; }
+		/// makes alloc() start concurrent collections instead of full stop the world ones
+		inline void set_concurrent(bool enabled) { concurrent = enabled; }
+		inline const gc_config &config() const { return conf; }
+		/// changes the collection policy, the next collection is rescheduled by the new one
+		inline void set_config(const gc_config &config) {
+			conf = config;
+			pace(false);
+		}
+		/// call before overwriting references in obj, needed in generational mode and during concurrent marking
+		inline void write_barrier(void *obj) {
+			if (marking_active) {
+				[[unlikely]];
+				for_each_ref(obj, [this](void **slot) {
+					if (*slot) {
+						satb_push(*slot);
 					}
-					for (const auto &[from, o] : transfer_map) {
-						(void)from;
-						for (auto it = begin_fun(o); it; it = next_fun(o, *it)) {
-							auto tfi = transfer_map.find(**it);
-							if (tfi != transfer_map.end()) {
-								**it = reinterpret_cast<typename std::remove_reference<decltype(**it)>::type>(tfi->second);
-							}
-						}
+				});
+			}
+			remember(obj);
+		}
+		/**
+		 * call before storing references into fields of obj which didn't hold any yet, like when appending
+		 * to an array - the part of write_barrier() that generational mode needs
+		 */
+		inline void remember(void *obj) {
+			if (!generational) {
+				return;
+			}
+			if (is_big(obj)) {
+				[[unlikely]];
+				big_object_header *header = big_object_header_of(obj);
+				if (header->mark && !header->remembered) {
+					header->remembered = 1;
+					remembered_big_objects.push_back(obj);
+				}
+			} else {
+				block_type *b = obj_block<Geometry>(obj);
+				if (b->is_marked(obj) && !b->is_card_dirty(obj)) {
+					if (!b->has_dirty_cards()) {
+						remembered_blocks.push_back(b);
 					}
-					blocks.insert(blocks.end(), new_blocks.begin(), new_blocks.end());
+					b->dirty_card(obj);
 				}
 			}
-			for (block *b : blocks) {
-				b->prepare();
-				if (!b->is_full()) {
-					free_blocks_list.push_back(b);
-				}
+		}
+		/**
+		 * write barrier for a single reference slot inside a gc object, when the object itself isn't known,
+		 * for example when gclib::vector replaces its data - call it before overwriting the slot
+		 */
+		inline void write_barrier_slot(void **slot) {
+			if (marking_active && *slot) {
+				[[unlikely]];
+				satb_push(*slot);
+			}
+			if (generational) {
+				remembered_slots.push_back(slot);
+			}
+		}
+		/**
+		 * sets how many threads mark the heap, 1 means marking on the collecting thread only
+		 *
+		 * The other threads are kept in a pool, so the callbacks have to be safe to call from several
+		 * threads at once.
+		 */
+		inline void set_mark_threads(size_t threads) {
+			if (threads <= 1) {
+				mark_pool.reset();
+				mark_deques.reset();
+			} else {
+				mark_pool = std::make_unique<worker_pool>(threads);
+				mark_deques = std::make_unique<work_stealing_deque[]>(threads);
 			}
-			bump_end = bump = nullptr;
-			next_bump();
-			object_count = alive.size();
 		}
-		inline void add_root(void **root) { roots.insert(root); }
-		inline void remove_root(void **root) { roots.erase(root); }
+		inline size_t mark_threads() const { return mark_pool ? mark_pool->size() : 1; }
+		inline void add_root(void **root) {
+			if (shared) {
+				[[unlikely]];
+				std::lock_guard lock(roots_mutex);
+				roots.insert(root);
+				return;
+			}
+			roots.insert(root);
+		}
+		inline void remove_root(void **root) {
+			if (shared) {
+				[[unlikely]];
+				std::lock_guard lock(roots_mutex);
+				roots.erase(root);
+				return;
+			}
+			roots.erase(root);
+		}
 		inline void move_root(void **from, void **to) { remove_root(from); add_root(to); }
+		/// slot is cleared by collections which find its object dead, and updated if the object moves
+		inline void add_weak(void **slot) {
+			std::unique_lock lock(roots_mutex, std::defer_lock);
+			if (shared) {
+				lock.lock();
+			}
+			weak_slots.insert(slot);
+		}
+		inline void remove_weak(void **slot) {
+			std::unique_lock lock(roots_mutex, std::defer_lock);
+			if (shared) {
+				lock.lock();
+			}
+			weak_slots.erase(slot);
+		}
+		/// see ephemeron_map
+		inline void add_ephemerons(std::unordered_map<void *, void *> *table) {
+			std::unique_lock lock(roots_mutex, std::defer_lock);
+			if (shared) {
+				lock.lock();
+			}
+			ephemeron_tables.insert(table);
+		}
+		inline void remove_ephemerons(std::unordered_map<void *, void *> *table) {
+			std::unique_lock lock(roots_mutex, std::defer_lock);
+			if (shared) {
+				lock.lock();
+			}
+			ephemeron_tables.erase(table);
+		}
+		inline void add_weak_table(weak_table *table) {
+			std::unique_lock lock(roots_mutex, std::defer_lock);
+			if (shared) {
+				lock.lock();
+			}
+			weak_tables.insert(table);
+		}
+		inline void remove_weak_table(weak_table *table) {
+			std::unique_lock lock(roots_mutex, std::defer_lock);
+			if (shared) {
+				lock.lock();
+			}
+			weak_tables.erase(table);
+		}
+		/**
+		 * call on objects loaded from weak references, while a concurrent or incremental collection runs
+		 * it marks them, so they survive even if they were unreachable at its start
+		 */
+		inline void keep_alive(void *obj) {
+			if (marking_active && obj) {
+				[[unlikely]];
+				satb_push(obj);
+			}
+		}
+		/// the stack of short-lived roots, see handle_scope - with a shared heap, each thread has its own
+		inline handle_stack &handles() { return shared ? current_mutator().handles : handle_roots; }
+		template<typename T> inline handle<T> handle_of(T *obj) {
+			return handle<T>(handles().push(obj));
+		}
+		/**
+		 * lets several threads allocate from this gc, call it before other threads use it
+		 *
+		 * Each thread allocates from its own buffer, refilled with blocks from a shared list. A collection
+		 * stops all threads which use the gc (see attach_thread()) at their next safepoint: each alloc()
+		 * is one, threads which don't allocate for a while have to call safepoint() regularly, or
+		 * detach_thread() before they block. Collections are always full stop the world ones (they can still
+		 * use set_mark_threads()), generational, concurrent and incremental collections aren't used.
+		 * Roots may be added and removed from any thread, but the collector reads them without locking,
+		 * so threads which aren't attached may only change them when no collection runs. Turning it off
+		 * drops the buffers and handles of all threads, none of them may have a handle_scope open then.
+		 */
+		inline void set_shared_heap(bool enabled) {
+			if (enabled == shared) {
+				return;
+			}
+			if (enabled) {
+				generational = minor_allowed = concurrent = false;
+				finish_concurrent_collect();
+				collect();
+				shared = true;
+				bump_end = bump = nullptr;
+				recycle_blocks();
+			} else { // only the calling thread may use the gc now, the handles of the others are gone
+				shared = false;
+				mutators.clear();
+				id = new_id(); // the mutator_cache of every thread which used the gc points to a dropped mutator
+				recycled_blocks.store(nullptr, std::memory_order_relaxed);
+				collect();
+			}
+		}
+		inline bool shared_heap() const { return shared; }
+		/// registers the calling thread as a user of the shared heap, alloc() does that by itself
+		inline void attach_thread() {
+			current_mutator();
+		}
+		/**
+		 * unregisters the calling thread, its handles are released, collections don't wait for it anymore -
+		 * all handle_scopes the thread opened have to be closed before
+		 */
+		inline void detach_thread() {
+			mutator_cache &cache = current_cache();
+			std::unique_lock lock(mutators_mutex);
+			const auto it = std::find_if(mutators.begin(), mutators.end(), [](const std::unique_ptr<mutator> &m) {
+				return m->owner == std::this_thread::get_id();
+			});
+			if (it == mutators.end()) {
+				return;
+			}
+			assert((*it)->handles.empty() && "detach_thread() with handles left, a handle_scope would restore into the freed stack");
+			object_count += (*it)->objects;
+			mutators.erase(it);
+			if (cache.gc_id == id) {
+				cache = mutator_cache();
+			}
+			collector_cv.notify_all();
+		}
+		/// stops the calling thread while another one collects, if it's waiting for it
+		inline void safepoint() {
+			if (!safepoint_requested.load(std::memory_order_acquire)) {
+				return;
+			}
+			std::unique_lock lock(mutators_mutex);
+			park(lock);
+		}
 		template<typename T> inline T *new_uninit() { return (T *)(alloc(sizeof(T))); }
 		template<typename T, typename R> inline R *new_uninit_as() { return (R *)(alloc(sizeof(T))); }
 		template<typename T, typename ...Ts> inline T *new_(Ts &&...args) {
@@ -227,23 +775,345 @@ namespace gclib {
 		inline unique_root_type<R> make_unique_as(Ts &&...args) {
 			return unique_root_type<R>(new_as<T, R>(std::forward<Ts>(args)...), this);
 		}
-		inline uint64_t live_object_count() const { return object_count; }
+		template<typename T, typename ...Ts> inline handle<T> make_handle(Ts &&...args) {
+			return handle_of(new_<T>(std::forward<Ts>(args)...));
+		}
+		template<typename T, typename R, typename ...Ts> inline handle<R> make_handle_as(Ts &&...args) {
+			return handle_of(new_as<T, R>(std::forward<Ts>(args)...));
+		}
+		inline uint64_t live_object_count() const {
+			if (shared) {
+				std::lock_guard lock(mutators_mutex);
+				uint64_t count = object_count;
+				for (const std::unique_ptr<mutator> &m : mutators) {
+					count += m->objects;
+				}
+				return count;
+			}
+			return object_count;
+		}
+		/// bytes of the objects found live by the last collection
+		inline uint64_t live_byte_count() const { return old_marked_bytes; }
 		inline uint64_t block_count() const { return blocks.size(); }
 		inline uint64_t big_object_count() const { return big_objects.size(); }
+		inline uint64_t minor_collection_count() const { return minor_collections; }
+		inline uint64_t major_collection_count() const { return major_collections; }
+		/// pauses of the mutator (collections and their steps), a change of pause_count() means there was a new one
+		inline uint64_t pause_count() const { return pauses; }
+		inline std::chrono::steady_clock::duration last_pause() const { return last_pause_time; }
+		/**
+		 * writes a snapshot of the heap (see heap_snapshot) to out, tag_of(obj) gives the tag of every live object
+		 *
+		 * Live objects are found by tracing from the roots, without collecting, the line marks of the blocks
+		 * are the ones of the last collection. The values of ephemerons with reached keys are live as well,
+		 * though no reference leads to them. No other thread may use the gc meanwhile.
+		 */
+		template<typename TagFun>
+		inline void dump_heap(std::ostream &out, TagFun &&tag_of) {
+			finish_concurrent_collect();
+			snapshot_writer writer(out, Geometry::line_size, Geometry::block_size, Geometry::big_object_treshold);
+			writer.section(blocks.size());
+			for (block_type *b : blocks) {
+				writer.block(b, b->lines, block_type::line_groups);
+			}
+			std::vector<void **> root_slots;
+			const auto add_root_slot = [&root_slots](void **slot) {
+				if (*slot) {
+					root_slots.push_back(slot);
+				}
+			};
+			for (void **root : roots) {
+				add_root_slot(root);
+			}
+			handle_roots.for_each_slot(add_root_slot);
+			for (const std::unique_ptr<mutator> &m : mutators) {
+				m->handles.for_each_slot(add_root_slot);
+			}
+			writer.section(root_slots.size());
+			std::vector<void *> live;
+			std::unordered_set<void *> seen;
+			const auto reach = [&](void *obj) {
+				if (seen.insert(obj).second) {
+					live.push_back(obj);
+				}
+			};
+			for (void **slot : root_slots) {
+				writer.root(slot, *slot);
+				reach(*slot);
+			}
+			for (size_t traced = 0; traced < live.size();) {
+				for (; traced < live.size(); traced++) {
+					for_each_ref(live[traced], [&](void **slot) {
+						if (*slot) {
+							reach(*slot);
+						}
+					});
+				}
+				for (std::unordered_map<void *, void *> *table : ephemeron_tables) {
+					for (auto &[key, value] : *table) {
+						if (value && seen.contains(key)) {
+							reach(value);
+						}
+					}
+				}
+			}
+			writer.section(live.size());
+			std::vector<void *> refs;
+			for (void *o : live) {
+				refs.clear();
+				for_each_ref(o, [&refs](void **slot) {
+					if (*slot) {
+						refs.push_back(*slot);
+					}
+				});
+				writer.object(o, policy.size(o), static_cast<uint32_t>(tag_of(o)), static_cast<uint32_t>(refs.size()));
+				for (void *ref : refs) {
+					writer.ref(ref);
+				}
+			}
+		}
+		/// dump_heap with all tags 0
+		inline void dump_heap(std::ostream &out) {
+			dump_heap(out, [](void *) { return 0u; });
+		}
+		/// stats of the last finished collection
+		inline const collection_stats &last_collection_stats() const { return last_stats; }
+		/// listener gets called at the start and end of every collection, nullptr removes it - the gc doesn't own it
+		inline void set_listener(gc_listener *_listener) { listener = _listener; }
 	private:
-		std::vector<block *> blocks;
-		std::vector<void *> big_objects;
+		std::vector<block_type *> blocks;
+		large_object_space big_objects;
 		void *bump;
 		void *bump_end;
-		std::vector<block *> free_blocks_list;
+		std::vector<block_type *> free_blocks_list;
+		size_t sweep_cursor;
+		size_t sweep_limit;
 		std::unordered_set<void **> roots;
+		std::unordered_set<void **> weak_slots;
+		std::unordered_set<std::unordered_map<void *, void *> *> ephemeron_tables;
+		std::unordered_set<weak_table *> weak_tables;
+		handle_stack handle_roots;
+		struct copy_space {
+			void *bump = nullptr;
+			void *end = nullptr;
+			uint64_t objects = 0; // evacuated into this space
+			uint64_t bytes = 0;
+		};
+		gclib::mark_stack mark_stack; // reference slots, or objects tagged by object_entry
+		gclib::mark_stack concurrent_stack; // of the background marker, see concurrent_mark()
+		std::vector<void *> forwarding; // new addresses of evacuated objects, by candidate block and granule
+		std::vector<block_type *> evacuation_blocks;
+		std::mutex evacuation_mutex;
+		copy_space evacuation_space;
+		bool evacuating;
+		void *pinned; // its block isn't evacuated, see alloc_pinned()
+		std::unique_ptr<worker_pool> mark_pool;
+		std::unique_ptr<work_stealing_deque[]> mark_deques;
+		std::vector<block_type *> remembered_blocks;
+		std::vector<void *> remembered_big_objects;
+		std::vector<void **> remembered_slots;
 		uint64_t object_count;
-		size_t collet_counter;
-		ObjSizeFun size_fun;
-		PointerBeginFun begin_fun;
-		NextPointerFun next_fun;
+		uint64_t old_object_count;
+		uint64_t minor_collections;
+		uint64_t major_collections;
+		size_t minor_since_major;
+		gc_config conf;
+		uint64_t allocated_bytes; // since the last collection
+		uint64_t allocation_budget; // allocated_bytes which trigger the next collection
+		uint64_t marked_bytes;
+		uint64_t old_marked_bytes;
+		uint64_t concurrent_marked_bytes;
+		size_t pause_depth;
+		std::chrono::steady_clock::duration gc_time; // spent collecting since last_collection_end
+		std::chrono::steady_clock::time_point last_collection_end;
+		std::chrono::steady_clock::duration last_pause_time;
+		uint64_t pauses;
+		collection_stats stats; // of the running (or last) collection
+		collection_stats last_stats;
+		gc_listener *listener;
+		bool stats_ending; // the collection ended, the pause_timer finishes the stats and tells the listener
+		bool generational;
+		bool minor_allowed;
+		std::vector<void *> satb_buffer;
+		std::mutex satb_mutex;
+		std::vector<void *> satb_queue;
+		std::thread marker_thread;
+		std::atomic<bool> marker_done;
+		uint64_t concurrent_marked;
+		bool marking_active;
+		bool concurrent;
+		/// allocation state of a thread using a shared heap
+		struct mutator {
+			std::thread::id owner;
+			void *bump = nullptr;
+			void *bump_end = nullptr;
+			block_type *current = nullptr;
+			uint64_t objects = 0; // allocated since the last collection
+			void *pinned = nullptr;
+			handle_stack handles;
+		};
+		struct mutator_cache {
+			uint64_t gc_id = 0;
+			mutator *m = nullptr;
+		};
+		bool shared;
+		uint64_t id; // tells gcs apart in the mutator_cache, a new one when the mutators are dropped
+		mutable std::mutex mutators_mutex;
+		std::vector<std::unique_ptr<mutator>> mutators;
+		std::condition_variable collector_cv; // parked threads and detaching ones wake the collector
+		std::condition_variable resume_cv;
+		std::atomic<bool> safepoint_requested;
+		size_t parked;
+		uint64_t collection_epoch;
+		std::atomic<block_type *> recycled_blocks; // only pushed to while the world is stopped, so no ABA
+		std::mutex blocks_mutex;
+		std::mutex roots_mutex;
+		[[no_unique_address]] Policy policy;
 
+		static inline uint64_t new_id() {
+			static std::atomic<uint64_t> next_id = 1;
+			return next_id.fetch_add(1, std::memory_order_relaxed);
+		}
+		static inline mutator_cache &current_cache() {
+			thread_local mutator_cache cache;
+			return cache;
+		}
+		inline mutator &current_mutator() {
+			mutator_cache &cache = current_cache();
+			if (cache.gc_id == id) {
+				[[likely]];
+				return *cache.m;
+			}
+			std::unique_lock lock(mutators_mutex);
+			mutator *m = nullptr;
+			for (const std::unique_ptr<mutator> &candidate : mutators) {
+				if (candidate->owner == std::this_thread::get_id()) {
+					m = candidate.get();
+				}
+			}
+			if (m == nullptr) {
+				// a running collection only waits for the threads it knows about, and reads the list of them
+				resume_cv.wait(lock, [this]() { return !safepoint_requested.load(std::memory_order_relaxed); });
+				mutators.push_back(std::make_unique<mutator>());
+				m = mutators.back().get();
+				m->owner = std::this_thread::get_id();
+			}
+			cache.gc_id = id;
+			cache.m = m;
+			return *m;
+		}
+		/// waits until the running collection ends, mutators_mutex has to be locked
+		inline void park(std::unique_lock<std::mutex> &lock) {
+			if (!safepoint_requested.load(std::memory_order_relaxed)) {
+				return;
+			}
+			const uint64_t epoch = collection_epoch;
+			parked++;
+			collector_cv.notify_all();
+			resume_cv.wait(lock, [&]() { return collection_epoch != epoch; });
+		}
+		/**
+		 * waits until all other attached threads are parked, returns false if another thread was about to
+		 * collect (the calling thread then waited for that collection to end instead)
+		 */
+		inline bool stop_the_world() {
+			bool expected = false;
+			if (!safepoint_requested.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+				safepoint();
+				return false;
+			}
+			std::unique_lock lock(mutators_mutex);
+			collector_cv.wait(lock, [this]() {
+				const bool attached = std::any_of(mutators.begin(), mutators.end(), [](const std::unique_ptr<mutator> &m) {
+					return m->owner == std::this_thread::get_id();
+				});
+				return parked == mutators.size() - attached;
+			});
+			for (const std::unique_ptr<mutator> &m : mutators) {
+				object_count += m->objects;
+				m->objects = 0;
+				m->bump = m->bump_end = nullptr;
+				m->current = nullptr;
+			}
+			return true;
+		}
+		inline void resume_the_world() {
+			std::lock_guard lock(mutators_mutex);
+			parked = 0;
+			collection_epoch++;
+			safepoint_requested.store(false, std::memory_order_release);
+			resume_cv.notify_all();
+		}
+		inline void *alloc_shared(size_t bytes) {
+			if (safepoint_requested.load(std::memory_order_acquire)) {
+				[[unlikely]];
+				safepoint();
+			}
+			mutator &m = current_mutator();
+			if (bytes > Geometry::big_object_treshold) {
+				[[unlikely]];
+				void *out;
+				{
+					std::lock_guard lock(blocks_mutex);
+					out = big_objects.alloc(bytes);
+				}
+				m.objects++;
+				charge(bytes);
+				return out;
+			}
+			while (static_cast<size_t>((uint8_t *)m.bump_end - (uint8_t *)m.bump) < bytes) {
+				refill(m);
+			}
+			void *out = m.bump;
+			m.bump = (uint8_t *)m.bump + bytes;
+			m.objects++;
+			return out;
+		}
+		/// gives m the next free range of its block, or of a block from the shared list, or of a new block
+		inline void refill(mutator &m) {
+			if (m.current == nullptr || m.current->is_full()) {
+				block_type *b = recycled_blocks.load(std::memory_order_acquire);
+				while (b && !recycled_blocks.compare_exchange_weak(b, b->next_recycled, std::memory_order_acquire)) { }
+				if (b == nullptr) {
+					b = alloc_block<Geometry>();
+					std::lock_guard lock(blocks_mutex);
+					blocks.push_back(b);
+				}
+				m.current = b;
+			}
+			m.current->next_range(&m.bump, &m.bump_end);
+			charge((uint8_t *)m.bump_end - (uint8_t *)m.bump);
+		}
+		/// counts bytes taken by a thread of a shared heap, and collects if they are over the budget
+		inline void charge(uint64_t bytes) {
+			const uint64_t total = std::atomic_ref<uint64_t>(allocated_bytes).fetch_add(bytes, std::memory_order_relaxed) + bytes;
+			if (total >= std::atomic_ref<uint64_t>(allocation_budget).load(std::memory_order_relaxed)) {
+				[[unlikely]];
+				collect();
+			}
+		}
+		/// makes all blocks with free lines available to the threads of a shared heap
+		inline void recycle_blocks() {
+			block_type *head = nullptr;
+			for (block_type *b : blocks) {
+				b->prepare();
+				if (!b->is_full()) {
+					b->next_recycled = head;
+					head = b;
+				}
+			}
+			recycled_blocks.store(head, std::memory_order_release);
+		}
 		inline void next_bump() {
+			// lazy sweeping, blocks are only prepared when the allocator gets to them - not while marking
+			// runs, since their line marks are being rebuilt
+			while (free_blocks_list.empty() && sweep_cursor < sweep_limit && !marking_active) {
+				block_type *b = blocks[sweep_cursor++];
+				b->prepare();
+				if (!b->is_full()) {
+					free_blocks_list.push_back(b);
+				}
+			}
 			if (free_blocks_list.empty()) {
 				bump_end = bump = nullptr;
 				return;
@@ -267,43 +1137,571 @@ namespace gclib {
 			return nullptr;
 		}
 		inline void add_block() {
-			blocks.push_back(alloc_block());
+			blocks.push_back(alloc_block<Geometry>());
 			blocks.back()->next_range(&bump, &bump_end);
 		}
-		inline void mark(void *obj, std::unordered_set<void *> &alive) {
-			if (alive.contains(obj)) {
+		inline bool is_big(void *obj) {
+			return policy.size(obj) > Geometry::big_object_treshold;
+		}
+		inline void push_root_slots() {
+			for (void **root : roots) {
+				mark_stack.push(root);
+			}
+			handle_roots.for_each_slot([this](void **slot) { mark_stack.push(slot); });
+			for (const std::unique_ptr<mutator> &m : mutators) {
+				m->handles.for_each_slot([this](void **slot) { mark_stack.push(slot); });
+			}
+		}
+		/// pushes the objects the roots point to now, for marking a snapshot while the roots change
+		inline void push_root_objects() {
+			const auto push = [this](void **root) {
+				if (*root) {
+					mark_stack.push(object_entry(*root));
+				}
+			};
+			for (void **root : roots) {
+				push(root);
+			}
+			handle_roots.for_each_slot(push);
+		}
+		/// records the time until its destruction as a pause and adds it to gc_time, unless it's nested in another one
+		class pause_timer {
+		public:
+			inline explicit pause_timer(basic_gc &_gc) : gc(_gc), start(std::chrono::steady_clock::now()) {
+				gc.pause_depth++;
+			}
+			inline ~pause_timer() {
+				if (--gc.pause_depth == 0) {
+					gc.last_pause_time = std::chrono::steady_clock::now() - start;
+					gc.gc_time += gc.last_pause_time;
+					gc.pauses++;
+					gc.stats.pause += gc.last_pause_time;
+					if (gc.stats_ending) {
+						gc.end_stats();
+					}
+				}
+			}
+		private:
+			basic_gc &gc;
+			std::chrono::steady_clock::time_point start;
+		};
+		/// adds the time until its destruction to a phase
+		class phase_timer {
+		public:
+			inline explicit phase_timer(std::chrono::steady_clock::duration &_into) : into(_into), start(std::chrono::steady_clock::now()) { }
+			inline ~phase_timer() { into += std::chrono::steady_clock::now() - start; }
+		private:
+			std::chrono::steady_clock::duration &into;
+			std::chrono::steady_clock::time_point start;
+		};
+		/**
+		 * sets the allocation budget until the next collection from the live bytes and the config, after
+		 * a collection (collection_end) it also starts measuring the time spent collecting anew
+		 */
+		inline void pace(bool collection_end) {
+			const auto now = std::chrono::steady_clock::now();
+			const double live = static_cast<double>(old_marked_bytes);
+			double target = std::max(live * conf.heap_growth, static_cast<double>(conf.min_heap_bytes));
+			if (conf.gc_cpu_share > 0 && now > last_collection_end) {
+				const double share = std::chrono::duration<double>(gc_time) / std::chrono::duration<double>(now - last_collection_end);
+				if (share > conf.gc_cpu_share) {
+					target = live + (target - live) * std::min(share / conf.gc_cpu_share, max_pacing_stretch);
+				}
+			}
+			if (conf.max_heap_bytes) {
+				target = std::min(target, static_cast<double>(conf.max_heap_bytes));
+			}
+			allocation_budget = std::max(target > live ? static_cast<uint64_t>(target - live) : 0, static_cast<uint64_t>(Geometry::block_size));
+			if (collection_end) {
+				gc_time = std::chrono::steady_clock::duration::zero();
+				last_collection_end = now;
+			}
+		}
+		/// objects on the mark stack have their lowest bit set, to tell them apart from reference slots
+		static inline void *object_entry(void *obj) {
+			return reinterpret_cast<uint8_t *>(obj) + 1;
+		}
+		/// starts loading the object of a mark stack entry into the cache
+		static inline void prefetch_entry(void *entry) {
+			if (reinterpret_cast<uintptr_t>(entry) & 1) {
+				prefetch(reinterpret_cast<uint8_t *>(entry) - 1);
+			} else {
+				prefetch(*reinterpret_cast<void **>(entry));
+			}
+		}
+		/**
+		 * the next entry to mark, which went through queue to have its object prefetched by now - nullptr
+		 * once both stack (a mark_stack or a work_stealing_deque) and queue are empty
+		 */
+		template<typename Stack>
+		static inline void *next_entry(Stack &stack, prefetch_queue &queue) {
+			while (void *entry = stack.pop()) {
+				prefetch_entry(entry);
+				if ((entry = queue.exchange(entry)) != nullptr) {
+					return entry;
+				}
+			}
+			return queue.pop();
+		}
+		/// calls fun with every reference slot of obj (as void **)
+		template<typename Fun>
+		inline void for_each_ref(void *obj, Fun &&fun) {
+			auto visit = [&fun](auto slot) { fun(reinterpret_cast<void **>(slot)); };
+			policy.trace(obj, visit);
+		}
+		inline void trace_refs(void *o) {
+			for_each_ref(o, [this](void **slot) {
+				if (*slot) {
+					mark_stack.push(slot);
+				}
+			});
+		}
+		inline void drain_mark_stack() {
+			if (mark_pool && !mark_stack.empty()) {
+				parallel_drain_mark_stack();
 				return;
 			}
-			std::stack<void *> stack;
-			stack.push(obj);
-			while (!stack.empty()) {
-				void *o = stack.top();
-				stack.pop();
-				if (alive.contains(o)) {
+			mark_some(std::numeric_limits<size_t>::max());
+		}
+		/// marks at most limit objects from the mark stack
+		inline void mark_some(size_t limit) {
+			prefetch_queue queue;
+			for (; limit; limit--) {
+				void *entry = next_entry(mark_stack, queue);
+				if (entry == nullptr) {
+					return;
+				}
+				void *o = mark_entry<false>(entry, evacuation_space, marked_bytes);
+				if (o == nullptr) {
 					continue;
 				}
-				alive.insert(o);
-				size_t o_size = size_fun(o);
-				if (o_size <= big_object_treshold) {
-					block *b = obj_block(o);
+				object_count++;
+				trace_refs(o);
+			}
+			// the next slice marks the prefetched ones
+			while (void *entry = queue.pop()) {
+				mark_stack.push(entry);
+			}
+		}
+		/**
+		 * marks the object a mark stack entry refers to, returns it if it wasn't marked yet, nullptr otherwise
+		 *
+		 * Objects in evacuation candidate blocks are copied out when they're reached for the first time and
+		 * the slot they were reached through is updated, the copy is what gets marked and returned. In
+		 * evacuating collections all entries are slots, objects only come from snapshot roots and barriers.
+		 */
+		template<bool Atomic>
+		inline void *mark_entry(void *entry, copy_space &space, uint64_t &bytes) {
+			void **slot = nullptr;
+			void *o;
+			if (reinterpret_cast<uintptr_t>(entry) & 1) {
+				o = reinterpret_cast<uint8_t *>(entry) - 1;
+			} else {
+				slot = reinterpret_cast<void **>(entry);
+				o = *slot;
+			}
+			if (o == nullptr) {
+				return nullptr;
+			}
+			size_t o_size = policy.size(o);
+			if (o_size <= Geometry::big_object_treshold) {
+				block_type *b = obj_block<Geometry>(o);
+				if (b->flag != not_evacuated) {
+					[[unlikely]];
+					o = evacuate<Atomic>(o, o_size, b, slot, space);
+					if (o == nullptr) {
+						return nullptr;
+					}
+					b = obj_block<Geometry>(o);
+				}
+				if constexpr (Atomic) {
+					if (b->mark_atomic(o)) {
+						return nullptr;
+					}
+					b->add_object_atomic(o, o_size);
+				} else {
+					if (b->mark(o)) {
+						return nullptr;
+					}
 					b->add_object(o, o_size);
 				}
-				for (auto it = begin_fun(o); it; it = next_fun(o, *it)) {
-					stack.push(**it);
+			} else {
+				big_object_header *header = big_object_header_of(o);
+				if constexpr (Atomic) {
+					if (std::atomic_ref<uint64_t>(header->mark).exchange(1, std::memory_order_relaxed)) {
+						return nullptr;
+					}
+				} else {
+					if (header->mark) {
+						return nullptr;
+					}
+					header->mark = 1;
 				}
 			}
+			bytes += bytes_to_maxalings(o_size)*max_align;
+			return o;
+		}
+		/// copies o out of its block, or only updates slot if that already happened, returns the copy in the first case
+		template<bool Atomic>
+		inline void *evacuate(void *o, size_t o_size, block_type *b, void **slot, copy_space &space) {
+			void *&forward = forwarding[b->flag * block_type::block_granules + b->granule_of(o)];
+			// in candidate blocks, the mark bit means that the object was (or is being) evacuated
+			if (Atomic ? b->mark_atomic(o) : b->mark(o)) {
+				void *to;
+				if constexpr (Atomic) {
+					while ((to = std::atomic_ref<void *>(forward).load(std::memory_order_acquire)) == nullptr) {
+						std::this_thread::yield();
+					}
+				} else {
+					to = forward;
+				}
+				*slot = to;
+				return nullptr;
+			}
+			const size_t bytes = bytes_to_maxalings(o_size)*max_align;
+			if (static_cast<size_t>((uint8_t *)space.end - (uint8_t *)space.bump) < bytes) {
+				block_type *to_block = alloc_block<Geometry>();
+				to_block->live_bytes = 0; // counts the copies marked in it
+				{
+					std::unique_lock lock(evacuation_mutex, std::defer_lock);
+					if constexpr (Atomic) {
+						lock.lock();
+					}
+					evacuation_blocks.push_back(to_block);
+				}
+				to_block->next_range(&space.bump, &space.end);
+			}
+			void *to = space.bump;
+			space.bump = (uint8_t *)space.bump + bytes;
+			space.objects++;
+			space.bytes += bytes;
+			std::memcpy(to, o, o_size);
+			if constexpr (Atomic) {
+				std::atomic_ref<void *>(forward).store(to, std::memory_order_release);
+			} else {
+				forward = to;
+			}
+			*slot = to;
+			return to;
+		}
+		inline void parallel_drain_mark_stack() {
+			const size_t workers = mark_pool->size();
+			size_t i = 0;
+			mark_stack.for_each([&](void *entry) { mark_deques[i++ % workers].push(entry); });
+			mark_stack.clear();
+			std::vector<copy_space> spaces(workers);
+			std::atomic<size_t> idle = 0;
+			std::atomic<uint64_t> marked = 0;
+			std::atomic<uint64_t> bytes = 0;
+			mark_pool->run([&](size_t id) {
+				work_stealing_deque &own = mark_deques[id];
+				prefetch_queue queue;
+				uint64_t count = 0;
+				uint64_t own_bytes = 0;
+				size_t victim = id;
+				while (true) {
+					void *entry = next_entry(own, queue);
+					for (size_t tries = 0; entry == nullptr && tries < 2 * workers; tries++) {
+						victim = (victim + 1) % workers;
+						if (victim != id) {
+							entry = mark_deques[victim].steal();
+						}
+					}
+					if (entry == nullptr) {
+						if (wait_for_mark_work(idle, workers)) {
+							break;
+						}
+						continue;
+					}
+					void *o = mark_entry<true>(entry, spaces[id], own_bytes);
+					if (o == nullptr) {
+						continue;
+					}
+					count++;
+					for_each_ref(o, [&](void **slot) {
+						if (*slot) {
+							own.push(slot);
+						}
+					});
+				}
+				marked.fetch_add(count, std::memory_order_relaxed);
+				bytes.fetch_add(own_bytes, std::memory_order_relaxed);
+			});
+			for (size_t i = 0; i < workers; i++) {
+				mark_deques[i].reset();
+				evacuation_space.objects += spaces[i].objects;
+				evacuation_space.bytes += spaces[i].bytes;
+			}
+			object_count += marked.load(std::memory_order_relaxed);
+			marked_bytes += bytes.load(std::memory_order_relaxed);
+		}
+		/// the background marker, marks concurrent_stack and the satb_queue until both are empty
+		inline void concurrent_mark() {
+			copy_space no_evacuation;
+			prefetch_queue queue;
+			uint64_t count = 0;
+			uint64_t bytes = 0;
+			while (true) {
+				while (void *entry = next_entry(concurrent_stack, queue)) {
+					void *o = mark_entry<true>(entry, no_evacuation, bytes);
+					if (o == nullptr) {
+						continue;
+					}
+					count++;
+					for_each_ref(o, [&](void **slot) {
+						if (*slot) {
+							concurrent_stack.push(slot);
+						}
+					});
+				}
+				{
+					std::lock_guard lock(satb_mutex);
+					concurrent_stack.append(satb_queue);
+				}
+				if (concurrent_stack.empty()) {
+					break;
+				}
+			}
+			concurrent_marked = count;
+			concurrent_marked_bytes = bytes;
+			marker_done.store(true, std::memory_order_release);
+		}
+		inline void satb_push(void *obj) {
+			satb_buffer.push_back(object_entry(obj));
+			if (satb_buffer.size() >= satb_buffer_size) {
+				std::lock_guard lock(satb_mutex);
+				satb_queue.insert(satb_queue.end(), satb_buffer.begin(), satb_buffer.end());
+				satb_buffer.clear();
+			}
+		}
+		/// returns true once all workers ran out of work, false if there is something to steal again
+		inline bool wait_for_mark_work(std::atomic<size_t> &idle, size_t workers) {
+			idle.fetch_add(1);
+			while (idle.load() != workers) {
+				for (size_t i = 0; i < workers; i++) {
+					if (!mark_deques[i].empty()) {
+						idle.fetch_sub(1);
+						return false;
+					}
+				}
+				std::this_thread::yield();
+			}
+			return true;
+		}
+		/// where a marked object is after marking (evacuated objects move), nullptr if it's dead
+		inline void *live_address(void *o) {
+			if (policy.size(o) > Geometry::big_object_treshold) {
+				return big_object_header_of(o)->mark ? o : nullptr;
+			}
+			block_type *b = obj_block<Geometry>(o);
+			if (!b->is_marked(o)) {
+				return nullptr;
+			}
+			// in candidate blocks, the mark bit means that the object was evacuated
+			return b->flag == not_evacuated ? o : forwarding[b->flag * block_type::block_granules + b->granule_of(o)];
+		}
+		/**
+		 * after marking, traces the values of ephemerons with live keys until no more keys come alive, then
+		 * clears the weak references, removes the ephemerons whose objects died and sweeps the weak tables
+		 */
+		inline void process_weak_refs() {
+			for (bool traced = true; traced;) {
+				traced = false;
+				for (std::unordered_map<void *, void *> *table : ephemeron_tables) {
+					for (auto &[key, value] : *table) {
+						if (value && !live_address(value) && live_address(key)) {
+							mark_stack.push(&value);
+							traced = true;
+						}
+					}
+				}
+				drain_mark_stack();
+			}
+			for (void **slot : weak_slots) {
+				if (*slot) {
+					*slot = live_address(*slot);
+				}
+			}
+			for (std::unordered_map<void *, void *> *table : ephemeron_tables) {
+				if (!evacuating) {
+					std::erase_if(*table, [this](const std::pair<void *const, void *> &entry) { return !live_address(entry.first); });
+					continue;
+				}
+				std::unordered_map<void *, void *> moved;
+				moved.reserve(table->size());
+				for (auto &[key, value] : *table) {
+					if (void *new_key = live_address(key)) {
+						moved.emplace(new_key, value ? live_address(value) : nullptr);
+					}
+				}
+				table->swap(moved);
+			}
+			for (weak_table *table : weak_tables) {
+				table->sweep([](void *self, void *obj) { return static_cast<basic_gc *>(self)->live_address(obj); }, this);
+			}
+		}
+		inline void start_major_collection() {
+			major_collections++;
+			minor_since_major = 0;
+			clear_remembered_set();
+			for (block_type *b : blocks) {
+				b->clear();
+			}
+			big_objects.clear_marks();
+			object_count = 0;
+			marked_bytes = 0;
+		}
+		inline void finish_major_collection() {
+			{
+				phase_timer phase(stats.phases.big_sweep);
+				big_objects.sweep();
+			}
+			{
+				phase_timer phase(stats.phases.evacuation);
+				free_evacuated_blocks();
+			}
+			finish_collection();
+			minor_allowed = generational;
+		}
+		/**
+		 * picks blocks for evacuation, their live objects are then copied out while marking and the blocks
+		 * are freed afterwards
+		 *
+		 * Evacuating a block frees all of it for copying its live bytes, so the blocks with holes (from the
+		 * line marks of the last collection) which had the least live bytes then are picked first. Blocks
+		 * above max_evacuation_live_ratio are left alone, and the candidates are capped by compact_ratio
+		 * and evacuation_budget_bytes.
+		 */
+		inline void select_evacuation_candidates() {
+			if (blocks.size() <= conf.compact_ratio) {
+				return;
+			}
+			std::vector<const block_type *> pinned_blocks;
+			if (pinned) {
+				pinned_blocks.push_back(obj_block<Geometry>(pinned));
+			}
+			for (const std::unique_ptr<mutator> &m : mutators) {
+				if (m->pinned) {
+					pinned_blocks.push_back(obj_block<Geometry>(m->pinned));
+				}
+			}
+			const uint64_t max_live = static_cast<uint64_t>(conf.max_evacuation_live_ratio * Geometry::block_size);
+			std::vector<std::pair<uint64_t, size_t>> blocks_by_live;
+			size_t unpinned_count = 0;
+			for (size_t i = 0; i < blocks.size(); i++) {
+				if (std::ranges::find(pinned_blocks, blocks[i]) != pinned_blocks.end()) {
+					continue;
+				}
+				unpinned_count++;
+				if (blocks[i]->live_bytes <= max_live && blocks[i]->count_holes() > 1) {
+					blocks_by_live.push_back({blocks[i]->live_bytes, i});
+				}
+			}
+			const size_t max_candidates = std::min(unpinned_count / conf.compact_ratio, blocks_by_live.size());
+			std::ranges::partial_sort(blocks_by_live, blocks_by_live.begin() + max_candidates);
+			size_t candidate_count = 0;
+			uint64_t budget = conf.evacuation_budget_bytes ? conf.evacuation_budget_bytes : std::numeric_limits<uint64_t>::max();
+			for (; candidate_count < max_candidates && blocks_by_live[candidate_count].first <= budget; candidate_count++) {
+				budget -= blocks_by_live[candidate_count].first;
+				blocks[blocks_by_live[candidate_count].second]->flag = candidate_count;
+			}
+			if (candidate_count == 0) {
+				return;
+			}
+			forwarding.assign(candidate_count * block_type::block_granules, nullptr);
+			evacuating = true;
+		}
+		inline void free_evacuated_blocks() {
+			if (!evacuating) {
+				return;
+			}
+			std::erase_if(blocks, [](block_type *b) {
+				if (b->flag == not_evacuated) {
+					return false;
+				}
+				free_block(b);
+				return true;
+			});
+			blocks.insert(blocks.end(), evacuation_blocks.begin(), evacuation_blocks.end());
+			evacuation_blocks.clear();
+			stats.evacuated_objects = evacuation_space.objects;
+			stats.evacuated_bytes = evacuation_space.bytes;
+			evacuation_space = copy_space();
+			evacuating = false;
+		}
+		inline void clear_remembered_set() {
+			for (block_type *b : remembered_blocks) {
+				b->clear_cards();
+			}
+			for (void *big : remembered_big_objects) {
+				big_object_header_of(big)->remembered = 0;
+			}
+			remembered_blocks.clear();
+			remembered_big_objects.clear();
+			remembered_slots.clear();
+		}
+		inline void finish_collection() {
+			phase_timer phase(stats.phases.prepare);
+			old_object_count = object_count;
+			old_marked_bytes = marked_bytes;
+			allocated_bytes = 0;
+			pace(true);
+			free_blocks_list.clear();
+			stats_ending = true;
+			if (shared) {
+				recycle_blocks();
+				return;
+			}
+			// blocks added after this are prepared by alloc_block, so only the current ones are unswept
+			sweep_cursor = 0;
+			sweep_limit = blocks.size();
+			bump_end = bump = nullptr;
+			next_bump();
+		}
+		inline void begin_stats(collection_kind kind) {
+			stats = collection_stats();
+			stats.number = major_collections + minor_collections + 1;
+			stats.kind = kind;
+			stats.start = std::chrono::steady_clock::now();
+			stats.allocated_bytes = allocated_bytes;
+			if (listener) {
+				listener->collection_start(stats);
+			}
+		}
+		/// fills the rest of the stats at the end of the last pause of a collection
+		inline void end_stats() {
+			stats_ending = false;
+			stats.end = std::chrono::steady_clock::now();
+			stats.marked_bytes = old_marked_bytes;
+			stats.marked_objects = old_object_count;
+			stats.blocks = blocks.size();
+			stats.big_objects = big_objects.size();
+			for (block_type *b : blocks) {
+				stats.hole_histogram[hole_bucket(b->count_holes())]++;
+				stats.live_histogram[live_bucket(b->live_bytes, Geometry::block_size)]++;
+			}
+			last_stats = stats;
+			if (listener) {
+				listener->collection_end(stats);
+			}
 		}
 	};
+	/// gc with the size, first reference and next reference callbacks given to the constructor
+	template<typename ObjSizeFun, typename PointerBeginFun, typename NextPointerFun>
+	using gc = basic_gc<callback_policy<ObjSizeFun, PointerBeginFun, NextPointerFun>>;
 	template<typename IterType>
 	using standard_gc = gc<std::function<size_t (void *)>,
 		  std::function<std::optional<IterType> (void *)>,
 		  std::function<std::optional<IterType> (void *, IterType)>>;
 	template<typename T, typename IterType>
-	using standard_gc_uroot = unique_root<T, std::function<size_t (void *)>,
-		  std::function<std::optional<IterType> (void *)>,
-		  std::function<std::optional<IterType> (void *, IterType)>>;
+	using standard_gc_uroot = unique_root<T, typename standard_gc<IterType>::policy_type>;
 	using void_gc = standard_gc<void **>;
 	template<typename T> using void_gc_uroot = standard_gc_uroot<T, void **>;
+	template<typename T> using void_gc_weak = weak_ref<T, void_gc::policy_type>;
+	template<typename K, typename V> using void_gc_ephemeron_map = ephemeron_map<K, V, void_gc::policy_type>;
+	/// gc with the size and trace callbacks given to the constructor, see trace_callback_policy
+	using visitor_gc = basic_gc<trace_callback_policy<std::function<size_t (void *)>, std::function<void (void *, ref_list &)>>>;
+	template<typename T> using visitor_gc_uroot = unique_root<T, visitor_gc::policy_type>;
 }
 
 #endif
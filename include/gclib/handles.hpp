@@ -0,0 +1,87 @@
+#ifndef GCLIB_HANDLES_HPP_
+#define GCLIB_HANDLES_HPP_
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "params.hpp"
+
+namespace gclib {
+	/**
+	 * a shadow stack of root slots, pushing and popping is a pointer bump
+	 *
+	 * Slots live in fixed size chunks which are never moved, so handles pointing to them stay valid.
+	 * Chunks are kept after popping for the next pushes.
+	 */
+	class handle_stack {
+	public:
+		struct position {
+			size_t chunk;
+			void **top;
+		};
+		handle_stack();
+		handle_stack(const handle_stack &) = delete;
+		inline void **push(void *obj) {
+			if (top == limit) {
+				[[unlikely]];
+				next_chunk();
+			}
+			*top = obj;
+			return top++;
+		}
+		inline position save() const { return { chunk, top }; }
+		inline bool empty() const { return chunk == 0 && top == chunks[0].get(); }
+		inline void restore(position p) {
+			chunk = p.chunk;
+			top = p.top;
+			limit = chunks[chunk].get() + handle_chunk_size;
+		}
+		template<typename Fun>
+		inline void for_each_slot(Fun &&fun) {
+			for (size_t i = 0; i <= chunk; i++) {
+				void **end = i == chunk ? top : chunks[i].get() + handle_chunk_size;
+				for (void **slot = chunks[i].get(); slot != end; slot++) {
+					fun(slot);
+				}
+			}
+		}
+	private:
+		std::vector<std::unique_ptr<void *[]>> chunks;
+		size_t chunk;
+		void **top;
+		void **limit;
+
+		void next_chunk();
+	};
+	/// a root in a handle_stack, only valid until the handle_scope it was created in ends
+	template<typename T>
+	class handle {
+	public:
+		using element_type = T;
+		constexpr inline explicit handle(void **_slot) noexcept : slot(_slot) { }
+		constexpr inline T *get() const noexcept { return reinterpret_cast<T *>(*slot); }
+		constexpr inline T &operator*() const noexcept { return *get(); }
+		constexpr inline T *operator->() const noexcept { return get(); }
+		template<typename R> constexpr inline R *as() const noexcept { return reinterpret_cast<R *>(*slot); }
+		constexpr inline void set(T *obj) const noexcept { *slot = obj; }
+	private:
+		void **slot;
+	};
+	/**
+	 * releases all handles created since its construction when it ends (like V8's HandleScope)
+	 *
+	 * Scopes have to be nested, a scope has to end before the scopes created before it.
+	 */
+	class handle_scope {
+	public:
+		template<typename Gc>
+		inline explicit handle_scope(Gc &gc) : handle_scope(gc.handles()) { }
+		inline explicit handle_scope(handle_stack &_stack) : stack(_stack), saved(_stack.save()) { }
+		handle_scope(const handle_scope &) = delete;
+		inline ~handle_scope() { stack.restore(saved); }
+	private:
+		handle_stack &stack;
+		handle_stack::position saved;
+	};
+}
+
+#endif
@@ -0,0 +1,408 @@
+#ifndef GCLIB_HASH_MAP_HPP_
+#define GCLIB_HASH_MAP_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include "block.hpp"
+#include "handles.hpp"
+#include "util.hpp"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GCLIB_SSE2_GROUPS
+#endif
+
+namespace gclib {
+	/**
+	 * control bytes of a hash_map table: empty, deleted, or the low 7 bits of the hash of a full slot
+	 *
+	 * Lookups match the 7 bits of a whole group of slots at once, with SSE2 where it's available.
+	 */
+	namespace hash_map_ctrl {
+		constexpr int8_t empty = -128;
+		constexpr int8_t deleted = -2;
+		constexpr size_t group_width = 16;
+		inline bool is_full(int8_t c) { return c >= 0; }
+
+		class group {
+		public:
+			inline explicit group(const int8_t *ctrl) {
+#ifdef GCLIB_SSE2_GROUPS
+				bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+#else
+				std::memcpy(bytes, ctrl, group_width);
+#endif
+			}
+			/// bit i is set if slot i has the hash bits h2
+			inline uint32_t match(int8_t h2) const {
+#ifdef GCLIB_SSE2_GROUPS
+				return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), bytes)));
+#else
+				uint32_t out = 0;
+				for (size_t i = 0; i < group_width; i++) {
+					out |= static_cast<uint32_t>(bytes[i] == h2) << i;
+				}
+				return out;
+#endif
+			}
+			inline uint32_t match_empty() const { return match(empty); }
+			inline uint32_t match_empty_or_deleted() const {
+#ifdef GCLIB_SSE2_GROUPS
+				// empty and deleted are the only negative control bytes, so their sign bits
+				return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+#else
+				uint32_t out = 0;
+				for (size_t i = 0; i < group_width; i++) {
+					out |= static_cast<uint32_t>(bytes[i] < 0) << i;
+				}
+				return out;
+#endif
+			}
+		private:
+#ifdef GCLIB_SSE2_GROUPS
+			__m128i bytes;
+#else
+			int8_t bytes[group_width];
+#endif
+		};
+	}
+
+	/**
+	 * where the parts of a hash_map table are - a table is one gc object: the header (with the magic
+	 * and the capacity, like vector data), capacity control bytes, then capacity slots
+	 */
+	template<typename K, typename V>
+	struct hash_map_layout {
+		struct slot {
+			K key;
+			V value;
+		};
+		struct data_header {
+			size_t header_magic;
+			size_t capacity;
+		};
+		static_assert(alignof(slot) <= max_align, "hash_map slots can't be aligned more than gc objects");
+		static constexpr size_t slots_offset(size_t capacity) {
+			return (sizeof(data_header) + capacity + alignof(slot) - 1) / alignof(slot) * alignof(slot);
+		}
+		static constexpr size_t bytes(size_t capacity) {
+			return slots_offset(capacity) + capacity * sizeof(slot);
+		}
+		static inline size_t capacity(const void *data) { return reinterpret_cast<const data_header *>(data)->capacity; }
+		static inline int8_t *ctrl(void *data) {
+			return reinterpret_cast<int8_t *>(data) + sizeof(data_header);
+		}
+		static inline slot *slots(void *data) {
+			return reinterpret_cast<slot *>(reinterpret_cast<uint8_t *>(data) + slots_offset(capacity(data)));
+		}
+	};
+	/// size of a hash_map table, for the size callback - like bytes_vec_data
+	template<typename K, typename V>
+	inline size_t bytes_hash_map_data(void *data) {
+		return hash_map_layout<K, V>::bytes(hash_map_layout<K, V>::capacity(data));
+	}
+	/// calls fun(key, value) for the entries of a hash_map table, for tracing the references in them
+	template<typename K, typename V, typename Fun>
+	inline void for_each_hash_map_entry(void *data, Fun &&fun) {
+		using layout = hash_map_layout<K, V>;
+		const size_t capacity = layout::capacity(data);
+		const int8_t *ctrl = layout::ctrl(data);
+		typename layout::slot *slots = layout::slots(data);
+		for (size_t i = 0; i < capacity; i++) {
+			if (hash_map_ctrl::is_full(ctrl[i])) {
+				fun(slots[i].key, slots[i].value);
+			}
+		}
+	}
+
+	/**
+	 * open addressing hash map in the gc heap (Swiss table style groups of 16 control bytes)
+	 *
+	 * Like vector, it has to live inside a gc object and its table is a gc object with Header as the
+	 * first field. Trace both data_ref() and old_data_ref(), the size of a table is
+	 * bytes_hash_map_data<K, V>() and its references are the ones in the keys and values which
+	 * for_each_hash_map_entry<K, V>() gives.
+	 *
+	 * It grows incrementally: the old table is kept next to the new one, and every insert or erase
+	 * moves one group of it, so growing never rehashes everything at once. Lookups check both tables
+	 * meanwhile.
+	 *
+	 * Keys are hashed by value, so don't use gc pointers hashed by their address as keys - objects can
+	 * be moved by the collector (see ephemeron_map for that). As any gc object, K and V can't have
+	 * destructors. Pointers to values are valid until the next insert, erase or allocation. Inserts
+	 * may allocate, the entry is kept where the collector updates it meanwhile (for the very first
+	 * insert, only if V is a pointer).
+	 */
+	template<typename K, typename V, size_t Header, typename GC, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+	class hash_map {
+		using layout = hash_map_layout<K, V>;
+		using slot = typename layout::slot;
+		static_assert(std::is_trivially_destructible_v<K> && std::is_trivially_destructible_v<V>, "gc objects can't have destructors");
+		static constexpr size_t min_capacity = hash_map_ctrl::group_width;
+		static constexpr bool holds_refs = may_hold_refs<K> || may_hold_refs<V>;
+
+		size_t _size;
+		size_t growth_left; // inserts into the table until it has to grow
+		void *_data;
+		void *_old_data; // the table before the last growth, until all of it is moved to _data
+		size_t migrated_groups;
+		uint64_t old_data_barrier; // the major collection whose snapshot marking saw the references in _old_data
+		GC *gc;
+		[[no_unique_address]] Hash hasher;
+		[[no_unique_address]] KeyEqual key_equal;
+	public:
+		inline hash_map(GC *_gc) : _size(0), growth_left(0), _data(nullptr), _old_data(nullptr), migrated_groups(0), old_data_barrier(0), gc(_gc) { }
+		hash_map(const hash_map &) = delete;
+		hash_map &operator=(const hash_map &) = delete;
+
+		inline size_t size() const { return _size; }
+		inline bool empty() const { return _size == 0; }
+		inline size_t capacity() const { return _data ? layout::capacity(_data) : 0; }
+		inline void **data_ref() { return &_data; }
+		inline void **old_data_ref() { return &_old_data; }
+
+		/// nullptr if key isn't in the map
+		inline V *find(const K &key) {
+			const size_t hash = hash_of(key);
+			if (slot *s = find_in(_data, key, hash)) {
+				return &s->value;
+			}
+			if (slot *s = find_in(_old_data, key, hash)) {
+				return &s->value;
+			}
+			return nullptr;
+		}
+		inline bool contains(const K &key) { return find(key) != nullptr; }
+		/// adds key if it isn't in the map yet, returns false (and keeps the old value) if it is
+		inline bool insert(const K &key, const V &value) {
+			if (find(key)) {
+				return false;
+			}
+			add(key, value, hash_of(key));
+			return true;
+		}
+		inline void insert_or_assign(const K &key, const V &value) {
+			if (V *existing = find(key)) {
+				before_overwrite(existing_table(existing));
+				*existing = value;
+				return;
+			}
+			add(key, value, hash_of(key));
+		}
+		/// value of key, a default constructed one is added if it isn't in the map
+		inline V &operator[](const K &key) {
+			if (V *existing = find(key)) {
+				return *existing;
+			}
+			return add(key, V(), hash_of(key))->value;
+		}
+		inline bool erase(const K &key) {
+			const size_t hash = hash_of(key);
+			void *table = _data;
+			slot *s = find_in(table, key, hash);
+			if (s == nullptr) {
+				table = _old_data;
+				s = find_in(table, key, hash);
+			}
+			if (s == nullptr) {
+				return false;
+			}
+			before_overwrite(table);
+			layout::ctrl(table)[s - layout::slots(table)] = hash_map_ctrl::deleted;
+			_size--;
+			migrate_step();
+			return true;
+		}
+		/// keeps the table, so filling the map again doesn't allocate
+		inline void clear() {
+			if (_data) {
+				before_overwrite(_data);
+				std::memset(layout::ctrl(_data), hash_map_ctrl::empty, capacity());
+				growth_left = max_load(capacity());
+			}
+			gc->write_barrier_slot(&_old_data);
+			_old_data = nullptr;
+			_size = 0;
+		}
+		/// makes room for n entries in total, finishing a running incremental growth
+		inline void reserve(size_t n) {
+			finish_migration();
+			if (n > _size + growth_left) {
+				grow(n);
+				finish_migration();
+			}
+		}
+		/// calls fun(key, value) for every entry
+		template<typename Fun>
+		inline void for_each(Fun &&fun) {
+			if (_data) {
+				for_each_hash_map_entry<K, V>(_data, fun);
+			}
+			if (_old_data) {
+				for_each_hash_map_entry<K, V>(_old_data, fun);
+			}
+		}
+	private:
+		static constexpr size_t max_load(size_t capacity) { return capacity - capacity / 8; }
+		inline size_t hash_of(const K &key) const {
+			// std::hash is the identity for integers on some standard libraries, so mix the bits
+			uint64_t h = static_cast<uint64_t>(hasher(key)) * 0x9e3779b97f4a7c15ull;
+			return static_cast<size_t>(h ^ (h >> 32));
+		}
+		static inline int8_t h2(size_t hash) { return static_cast<int8_t>(hash & 0x7f); }
+		/// calls fun(group index) along the probe sequence of hash until it returns true
+		template<typename Fun>
+		static inline void probe(size_t capacity, size_t hash, Fun &&fun) {
+			const size_t mask = capacity / hash_map_ctrl::group_width - 1;
+			size_t group = (hash >> 7) & mask;
+			// triangular numbers visit every group of a power of two count
+			for (size_t i = 1; !fun(group); i++) {
+				group = (group + i) & mask;
+			}
+		}
+		inline slot *find_in(void *table, const K &key, size_t hash) {
+			if (table == nullptr) {
+				return nullptr;
+			}
+			const int8_t *ctrl = layout::ctrl(table);
+			slot *slots = layout::slots(table);
+			const size_t groups = layout::capacity(table) / hash_map_ctrl::group_width;
+			slot *out = nullptr;
+			size_t probed = 0;
+			probe(layout::capacity(table), hash, [&](size_t group) {
+				const hash_map_ctrl::group g(ctrl + group * hash_map_ctrl::group_width);
+				for (uint32_t match = g.match(h2(hash)); match; match &= match - 1) {
+					slot *s = slots + group * hash_map_ctrl::group_width + std::countr_zero(match);
+					if (key_equal(s->key, key)) {
+						out = s;
+						return true;
+					}
+				}
+				return g.match_empty() != 0 || ++probed == groups;
+			});
+			return out;
+		}
+		/// first empty or deleted slot along the probe sequence, the table must have one
+		static inline size_t free_slot_in(void *table, size_t hash) {
+			const int8_t *ctrl = layout::ctrl(table);
+			size_t out = 0;
+			probe(layout::capacity(table), hash, [&](size_t group) {
+				const uint32_t match = hash_map_ctrl::group(ctrl + group * hash_map_ctrl::group_width).match_empty_or_deleted();
+				if (match) {
+					out = group * hash_map_ctrl::group_width + std::countr_zero(match);
+					return true;
+				}
+				return false;
+			});
+			return out;
+		}
+		/// puts an entry which isn't in the map yet into the current table
+		inline slot *add(const K &key, const V &value, size_t hash) {
+			if (_data == nullptr) {
+				if constexpr (std::is_pointer_v<V>) {
+					// nothing refers to value while the first table is allocated, a handle keeps it up to date
+					handle_scope scope(*gc);
+					const handle<std::remove_pointer_t<V>> held = gc->handle_of(value);
+					grow(1);
+					return add(key, held.get(), hash);
+				} else {
+					grow(1);
+				}
+			}
+			const size_t i = place(key, value, hash);
+			_size++;
+			if (growth_left == 0) {
+				// the entry is in the table before the next one is allocated, so it's updated if that moves what it refers to
+				grow(_size);
+				return layout::slots(_old_data) + i;
+			}
+			migrate_step();
+			return layout::slots(_data) + i;
+		}
+		/// index of the slot the entry went to, there is always an empty one left
+		inline size_t place(const K &key, const V &value, size_t hash) {
+			const size_t i = free_slot_in(_data, hash);
+			int8_t &c = layout::ctrl(_data)[i];
+			if (c == hash_map_ctrl::empty) {
+				growth_left--;
+			}
+			c = h2(hash);
+			if constexpr (holds_refs) gc->remember(_data);
+			slot *s = layout::slots(_data) + i;
+			new (&s->key) K(key);
+			new (&s->value) V(value);
+			return i;
+		}
+		/// allocates a new table for at least entries, the entries of the current one are moved to it by migrate_step
+		inline void grow(size_t entries) {
+			finish_migration();
+			size_t new_capacity = std::max(min_capacity, capacity());
+			while (max_load(new_capacity) < std::max(entries, 2 * _size)) {
+				new_capacity *= 2;
+			}
+			// a table full of deleted slots is rehashed at the same size
+			void *new_data = gc->alloc_pinned(layout::bytes(new_capacity), this);
+			reinterpret_cast<typename layout::data_header *>(new_data)->header_magic = Header;
+			reinterpret_cast<typename layout::data_header *>(new_data)->capacity = new_capacity;
+			std::memset(layout::ctrl(new_data), hash_map_ctrl::empty, new_capacity);
+			gc->write_barrier_slot(&_old_data);
+			_old_data = _data;
+			gc->write_barrier_slot(&_data);
+			_data = new_data;
+			growth_left = max_load(new_capacity);
+			migrated_groups = 0;
+			old_data_barrier = 0;
+		}
+		/// moves one group of the old table to the current one
+		inline void migrate_step() {
+			if (_old_data == nullptr) {
+				return;
+			}
+			// the moved entries go to a table which may be allocated during marking and never scanned, so the
+			// marker has to see them in the old one - once per collection is enough, nothing is added to it
+			if (gc->concurrent_collect_running() && old_data_barrier != gc->major_collection_count()) {
+				[[unlikely]];
+				before_overwrite(_old_data);
+				old_data_barrier = gc->major_collection_count();
+			}
+			int8_t *ctrl = layout::ctrl(_old_data);
+			slot *slots = layout::slots(_old_data);
+			const size_t first = migrated_groups * hash_map_ctrl::group_width;
+			for (size_t i = first; i < first + hash_map_ctrl::group_width; i++) {
+				if (hash_map_ctrl::is_full(ctrl[i])) {
+					// deleted instead of empty, so lookups in the old table still probe past it
+					ctrl[i] = hash_map_ctrl::deleted;
+					place(slots[i].key, slots[i].value, hash_of(slots[i].key));
+				}
+			}
+			if (++migrated_groups == layout::capacity(_old_data) / hash_map_ctrl::group_width) {
+				gc->write_barrier_slot(&_old_data);
+				_old_data = nullptr;
+			}
+		}
+		inline void finish_migration() {
+			while (_old_data) {
+				migrate_step();
+			}
+		}
+		inline void *existing_table(V *value) {
+			const uint8_t *p = reinterpret_cast<const uint8_t *>(value);
+			const uint8_t *begin = reinterpret_cast<const uint8_t *>(layout::slots(_data));
+			return p >= begin && p < begin + capacity() * sizeof(slot) ? _data : _old_data;
+		}
+		/// snapshot marking has to see the references in an entry before they're overwritten or dropped
+		inline void before_overwrite(void *table) {
+			if constexpr (holds_refs) {
+				if (gc->concurrent_collect_running()) {
+					[[unlikely]];
+					gc->write_barrier(table);
+				}
+			}
+		}
+	};
+}
+
+#endif
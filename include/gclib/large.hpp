@@ -0,0 +1,46 @@
+#ifndef GCLIB_LARGE_HPP_
+#define GCLIB_LARGE_HPP_
+#include <cstddef>
+#include <cstdint>
+#include "block.hpp"
+
+namespace gclib {
+	struct big_object_header {
+		big_object_header *prev;
+		big_object_header *next;
+		size_t run_bytes; // size of the page run holding the object, header included
+		uint64_t mark;
+		uint64_t remembered;
+	};
+	constexpr size_t big_object_header_size = bytes_to_maxalings(sizeof(big_object_header)) * max_align;
+	big_object_header *big_object_header_of(void *obj);
+
+	/**
+	 * big objects of one gc, each in its own run of pages
+	 *
+	 * Objects are kept in a doubly linked list threaded through their headers, so sweeping visits every
+	 * object once without any lookups. Freed page runs are cached (shared by all spaces) and reused for
+	 * later objects of similar size.
+	 */
+	class large_object_space {
+	public:
+		large_object_space();
+		large_object_space(const large_object_space &) = delete;
+		~large_object_space();
+		void *alloc(size_t bytes);
+		/**
+		 * grows obj to bytes without copying, in its page run if it has room or by remapping its pages -
+		 * returns the new address, or nullptr where pages can't be remapped
+		 */
+		void *resize(void *obj, size_t bytes);
+		/// frees all unmarked objects
+		void sweep();
+		void clear_marks();
+		inline size_t size() const { return count; }
+	private:
+		big_object_header *head;
+		size_t count;
+	};
+}
+
+#endif
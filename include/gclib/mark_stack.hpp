@@ -0,0 +1,122 @@
+#ifndef GCLIB_MARK_STACK_HPP_
+#define GCLIB_MARK_STACK_HPP_
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "params.hpp"
+
+namespace gclib {
+	/**
+	 * stack of mark entries in fixed size segments, pushing and popping is a pointer bump
+	 *
+	 * Segments are kept when the stack shrinks and reused by later pushes and collections, so a
+	 * collection doesn't copy the stack when it grows and doesn't allocate once the stack got as deep
+	 * as it needs to be.
+	 */
+	class mark_stack {
+	public:
+		mark_stack();
+		mark_stack(const mark_stack &) = delete;
+		inline void push(void *entry) {
+			if (top == limit) {
+				[[unlikely]];
+				next_segment();
+			}
+			*top++ = entry;
+		}
+		/// the last pushed entry, nullptr if the stack is empty
+		inline void *pop() {
+			if (top == base) {
+				[[unlikely]];
+				if (segment == 0) {
+					return nullptr;
+				}
+				previous_segment();
+			}
+			return *--top;
+		}
+		inline bool empty() const { return top == base && segment == 0; }
+		inline size_t size() const { return segment * mark_segment_entries + static_cast<size_t>(top - base); }
+		inline void clear() {
+			segment = 0;
+			base = top = segments[0].get();
+			limit = base + mark_segment_entries;
+		}
+		/// pushes all entries of v, and clears it
+		inline void append(std::vector<void *> &v) {
+			for (void *entry : v) {
+				push(entry);
+			}
+			v.clear();
+		}
+		/// exchanges the entries, segments included
+		inline void swap(mark_stack &o) noexcept {
+			segments.swap(o.segments);
+			std::swap(segment, o.segment);
+			std::swap(base, o.base);
+			std::swap(top, o.top);
+			std::swap(limit, o.limit);
+		}
+		template<typename Fun>
+		inline void for_each(Fun &&fun) {
+			for (size_t i = 0; i <= segment; i++) {
+				void **end = i == segment ? top : segments[i].get() + mark_segment_entries;
+				for (void **entry = segments[i].get(); entry != end; entry++) {
+					fun(*entry);
+				}
+			}
+		}
+	private:
+		std::vector<std::unique_ptr<void *[]>> segments;
+		size_t segment;
+		void **base;
+		void **top;
+		void **limit;
+
+		void next_segment();
+		void previous_segment();
+	};
+	/**
+	 * a few mark entries waiting for their objects to arrive in the cache (prefetch on grey)
+	 *
+	 * The marking loop prefetches the object of every entry it pops and passes the entry through
+	 * exchange(), which gives back the one passed mark_prefetch_distance calls earlier, whose object
+	 * should be in the cache by then. When the stack runs out, pop() hands out the rest.
+	 */
+	class prefetch_queue {
+	public:
+		/// queues entry, returns the oldest queued one if the queue was full, nullptr otherwise
+		inline void *exchange(void *entry) {
+			void *oldest = entries[head];
+			entries[head] = entry;
+			head = (head + 1) % mark_prefetch_distance;
+			return oldest;
+		}
+		/// removes and returns the oldest queued entry, nullptr if there's none
+		inline void *pop() {
+			for (size_t i = 0; i < mark_prefetch_distance; i++) {
+				void *&entry = entries[(head + i) % mark_prefetch_distance];
+				if (entry != nullptr) {
+					void *out = entry;
+					entry = nullptr;
+					return out;
+				}
+			}
+			return nullptr;
+		}
+	private:
+		void *entries[mark_prefetch_distance] = { };
+		size_t head = 0;
+	};
+	/// a hint to start loading the cache line at p, does nothing where it isn't supported
+	inline void prefetch(const void *p) {
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch(p);
+#else
+		(void)p;
+#endif
+	}
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef GCLIB_PARALLEL_HPP_
+#define GCLIB_PARALLEL_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gclib {
+	/**
+	 * Chase-Lev work stealing deque of non-null pointers
+	 *
+	 * Only the owning thread may push and pop, any thread may steal. pop and steal return nullptr when
+	 * there is nothing to take (steal also when it loses a race with another thief).
+	 */
+	class work_stealing_deque {
+	public:
+		work_stealing_deque();
+		work_stealing_deque(const work_stealing_deque &) = delete;
+		~work_stealing_deque();
+		void push(void *item);
+		void *pop();
+		void *steal();
+		bool empty() const;
+		/// frees buffers which were replaced by growing, only call when no other thread uses the deque
+		void reset();
+	private:
+		struct buffer {
+			size_t capacity;
+			std::unique_ptr<std::atomic<void *>[]> items;
+			explicit buffer(size_t _capacity);
+			inline void *get(int64_t i) const { return items[i & (capacity - 1)].load(std::memory_order_relaxed); }
+			inline void put(int64_t i, void *item) { items[i & (capacity - 1)].store(item, std::memory_order_relaxed); }
+		};
+		alignas(64) std::atomic<int64_t> top;
+		alignas(64) std::atomic<int64_t> bottom;
+		std::atomic<buffer *> items;
+		std::vector<std::unique_ptr<buffer>> buffers;
+	};
+	/// a pool of threads which run the same task together, the calling thread takes part as worker 0
+	class worker_pool {
+	public:
+		explicit worker_pool(size_t workers);
+		worker_pool(const worker_pool &) = delete;
+		~worker_pool();
+		inline size_t size() const { return threads.size() + 1; }
+		/// calls task(i) for every worker i and returns once all of them returned
+		void run(const std::function<void (size_t)> &task);
+	private:
+		std::vector<std::thread> threads;
+		std::mutex mutex;
+		std::condition_variable start_cv;
+		std::condition_variable done_cv;
+		const std::function<void (size_t)> *task;
+		uint64_t generation;
+		size_t running;
+		bool stopping;
+
+		void worker(size_t id);
+	};
+}
+
+#endif
+
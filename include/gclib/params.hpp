@@ -2,6 +2,7 @@
 #define GCLIB_PARAMS_HPP_
 
 #include <cstddef>
+#include <bit>
 
 namespace gclib {
 	constexpr size_t line_size = 128;
@@ -11,8 +12,39 @@ namespace gclib {
 	static_assert(block_size / line_size % 64 == 0);
 	constexpr size_t line_groups = block_size / line_size / 64;
 
-	constexpr size_t block_collect_factor = 128;
-	constexpr size_t block_compact_ratio = 20;
+	/**
+	 * sizes of lines and blocks, and the size above which objects are big (allocated on their own
+	 * instead of in blocks) - the default_geometry uses the constants above
+	 */
+	template<size_t LineSize, size_t BlockSize, size_t BigObjectTreshold = BlockSize / 4>
+	struct heap_geometry {
+		static constexpr size_t line_size = LineSize;
+		static constexpr size_t block_size = BlockSize;
+		static constexpr size_t big_object_treshold = BigObjectTreshold;
+		static_assert(std::has_single_bit(line_size) && std::has_single_bit(block_size));
+		static_assert(block_size / line_size % 64 == 0);
+		static_assert(big_object_treshold <= block_size / 2);
+		static constexpr size_t line_groups = block_size / line_size / 64;
+	};
+	using default_geometry = heap_geometry<line_size, block_size, big_object_treshold>;
+
+	/// blocks are carved from arenas of this many blocks, which are never returned to the system
+	constexpr size_t block_arena_blocks = 64;
+	/// ask for transparent huge pages for block arenas (where available)
+	constexpr bool block_arena_huge_pages = true;
+
+	/// freed page runs of big objects up to this many bytes are kept for reuse
+	constexpr size_t large_object_cache_size = 32 * 1024 * 1024;
+
+	/// gc_config::gc_cpu_share grows the heap between collections at most this many times more
+	constexpr double max_pacing_stretch = 4;
+	constexpr size_t satb_buffer_size = 256;
+	constexpr size_t incremental_mark_slice = 256;
+	constexpr size_t handle_chunk_size = 1024;
+	/// entries in a segment of the mark stack
+	constexpr size_t mark_segment_entries = 4096;
+	/// marking prefetches objects this many entries before it scans them
+	constexpr size_t mark_prefetch_distance = 8;
 }
 
 #endif
@@ -0,0 +1,85 @@
+#ifndef GCLIB_POLICY_HPP_
+#define GCLIB_POLICY_HPP_
+#include <cstddef>
+#include <concepts>
+#include <optional>
+#include <vector>
+
+namespace gclib {
+	namespace detail {
+		/// stands in for the visitors the gc passes to trace_policy::trace
+		struct any_slot_visitor {
+			template<typename T> void operator()(T **) const { }
+		};
+	}
+	/**
+	 * tells the gc about objects: size(obj) returns the size of obj in bytes, trace(obj, visit) calls
+	 * visit(slot) with a pointer to every reference field of obj (slots may have any pointer to pointer
+	 * type, and may hold nullptr)
+	 *
+	 * Both can be static, and are best defined inline, so they get inlined into marking. They may be
+	 * called from several threads at once with parallel or concurrent marking.
+	 */
+	template<typename Policy>
+	concept trace_policy = requires(Policy &policy, void *obj, detail::any_slot_visitor &visit) {
+		{ policy.size(obj) } -> std::convertible_to<size_t>;
+		policy.trace(obj, visit);
+	};
+	/**
+	 * trace_policy calling a size callback and the begin/next callbacks, which iterate through the
+	 * reference fields of an object, returning std::nullopt after the last one
+	 */
+	template<typename ObjSizeFun, typename PointerBeginFun, typename NextPointerFun>
+	struct callback_policy {
+		ObjSizeFun size_fun;
+		PointerBeginFun begin_fun;
+		NextPointerFun next_fun;
+		inline callback_policy(ObjSizeFun obj_size_fun, PointerBeginFun pointer_begin_fun, NextPointerFun next_pointer_fun) :
+			size_fun(obj_size_fun), begin_fun(pointer_begin_fun), next_fun(next_pointer_fun) { }
+		inline size_t size(void *obj) const { return size_fun(obj); }
+		template<typename Visitor>
+		inline void trace(void *obj, Visitor &visit) const {
+			for (auto it = begin_fun(obj); it; it = next_fun(obj, *it)) {
+				visit(*it);
+			}
+		}
+	};
+	/// the reference slots of one object, filled by the trace callback of trace_callback_policy
+	class ref_list {
+	public:
+		inline explicit ref_list(std::vector<void **> &_slots) : slots(_slots) { }
+		template<typename T> inline void operator()(T **slot) { slots.push_back(reinterpret_cast<void **>(slot)); }
+		/// adds the slots [begin, end), like the elements of an array of references
+		template<typename T> inline void push_range(T **begin, T **end) {
+			for (; begin != end; begin++) {
+				slots.push_back(reinterpret_cast<void **>(begin));
+			}
+		}
+	private:
+		std::vector<void **> &slots;
+	};
+	/**
+	 * trace_policy calling a size callback and a trace callback, which adds all reference fields of an
+	 * object to a ref_list at once - cheaper than begin/next for objects with several references
+	 */
+	template<typename ObjSizeFun, typename TraceFun>
+	struct trace_callback_policy {
+		ObjSizeFun size_fun;
+		TraceFun trace_fun;
+		inline trace_callback_policy(ObjSizeFun obj_size_fun, TraceFun obj_trace_fun) :
+			size_fun(obj_size_fun), trace_fun(obj_trace_fun) { }
+		inline size_t size(void *obj) const { return size_fun(obj); }
+		template<typename Visitor>
+		inline void trace(void *obj, Visitor &visit) const {
+			thread_local std::vector<void **> slots;
+			slots.clear();
+			ref_list list(slots);
+			trace_fun(obj, list);
+			for (void **slot : slots) {
+				visit(slot);
+			}
+		}
+	};
+}
+
+#endif
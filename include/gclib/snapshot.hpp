@@ -0,0 +1,76 @@
+#ifndef GCLIB_SNAPSHOT_HPP_
+#define GCLIB_SNAPSHOT_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace gclib {
+	/**
+	 * heap snapshots written by basic_gc::dump_heap()
+	 *
+	 * The format is a header followed by sections, each starting with its element count. All numbers are
+	 * little endian, addresses are u64:
+	 * - header: "GCHEAP01", u32 line_size, u32 block_size, u64 big_object_treshold
+	 * - blocks: address, then block_size/line_size/64 u64 words of live line marks from the last collection
+	 * - roots: address of the slot, address of the object
+	 * - objects: address, u64 size, u32 tag, u32 reference count, then the referenced addresses
+	 *
+	 * Objects bigger than big_object_treshold are big objects, the rest lives in the blocks.
+	 */
+	constexpr char snapshot_magic[8] = { 'G', 'C', 'H', 'E', 'A', 'P', '0', '1' };
+
+	class snapshot_writer {
+	public:
+		snapshot_writer(std::ostream &_out, uint32_t line_size, uint32_t block_size, uint64_t big_object_treshold);
+		/// starts a section of count elements
+		void section(uint64_t count);
+		void block(const void *address, const uint64_t *lines, size_t line_groups);
+		void root(void *const *slot, const void *obj);
+		/// has to be followed by ref_count ref() calls
+		void object(const void *address, uint64_t size, uint32_t tag, uint32_t ref_count);
+		void ref(const void *target);
+	private:
+		std::ostream &out;
+		void u32(uint32_t x);
+		void u64(uint64_t x);
+	};
+
+	struct heap_snapshot {
+		struct block {
+			uint64_t address;
+			std::vector<uint64_t> lines;
+		};
+		struct root {
+			uint64_t slot;
+			uint64_t object;
+		};
+		struct object {
+			uint64_t address;
+			uint64_t size;
+			uint32_t tag;
+			std::vector<uint64_t> refs;
+		};
+		uint32_t line_size = 0;
+		uint32_t block_size = 0;
+		uint64_t big_object_treshold = 0;
+		std::vector<block> blocks;
+		std::vector<root> roots;
+		std::vector<object> objects; // ordered by address
+
+		/// throws std::runtime_error if the stream doesn't hold a valid snapshot
+		static heap_snapshot read(std::istream &in);
+		/// index of the object at address, or objects.size() if there is none
+		size_t find(uint64_t address) const;
+		/**
+		 * bytes which would be freed with each object (its size and the sizes of all objects only
+		 * reachable through it), computed from the dominator tree of the object graph
+		 */
+		std::vector<uint64_t> retained_sizes() const;
+		/// immediate dominator of every object, objects.size() for the ones only dominated by the roots together
+		std::vector<size_t> dominators() const;
+	};
+}
+
+#endif
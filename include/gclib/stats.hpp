@@ -0,0 +1,82 @@
+#ifndef GCLIB_STATS_HPP_
+#define GCLIB_STATS_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <ostream>
+
+namespace gclib {
+	enum class collection_kind : uint8_t {
+		full, minor, concurrent, incremental
+	};
+	const char *collection_kind_name(collection_kind kind);
+	/// hole_histogram[i] counts blocks with 2^(i-1) to 2^i-1 holes (0 holes for i = 0), the last bucket also the ones with more
+	constexpr size_t hole_histogram_buckets = 8;
+	inline constexpr size_t hole_bucket(size_t holes) {
+		return std::min<size_t>(std::bit_width(holes), hole_histogram_buckets - 1);
+	}
+	/// live_histogram[i] counts blocks with i/live_histogram_buckets to (i+1)/live_histogram_buckets of their bytes live
+	constexpr size_t live_histogram_buckets = 10;
+	inline constexpr size_t live_bucket(uint64_t live_bytes, size_t block_bytes) {
+		return std::min<size_t>(live_bytes * live_histogram_buckets / block_bytes, live_histogram_buckets - 1);
+	}
+	/// time spent in the parts of a collection, summed over all its pauses (background marking isn't included)
+	struct phase_times {
+		std::chrono::steady_clock::duration root_scan{}; // roots, and remembered objects in minor collections
+		std::chrono::steady_clock::duration mark{};
+		std::chrono::steady_clock::duration big_sweep{};
+		std::chrono::steady_clock::duration evacuation{}; // picking the candidates and freeing them, copying is a part of marking
+		std::chrono::steady_clock::duration prepare{}; // resetting the allocator, blocks are swept lazily by alloc() later
+	};
+	struct collection_stats {
+		uint64_t number = 0; // counts both minor and major collections, from 1
+		collection_kind kind = collection_kind::full;
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::time_point end;
+		std::chrono::steady_clock::duration pause{}; // the mutator was stopped for this long in total
+		phase_times phases;
+		uint64_t allocated_bytes = 0; // since the previous collection
+		uint64_t marked_bytes = 0;
+		uint64_t marked_objects = 0;
+		uint64_t evacuated_bytes = 0;
+		uint64_t evacuated_objects = 0;
+		uint64_t blocks = 0; // at the end of the collection
+		uint64_t big_objects = 0;
+		uint64_t hole_histogram[hole_histogram_buckets] = { };
+		uint64_t live_histogram[live_histogram_buckets] = { };
+	};
+	/**
+	 * gets told about the collections of a gc it's attached to with set_listener()
+	 *
+	 * Both calls happen in a pause, on the thread which does it. Concurrent and incremental collections
+	 * start in one pause and end in another.
+	 */
+	class gc_listener {
+	public:
+		virtual ~gc_listener() = default;
+		/// stats has only the number, kind, start and allocated_bytes filled
+		virtual void collection_start(const collection_stats &stats) { (void)stats; }
+		virtual void collection_end(const collection_stats &stats) { (void)stats; }
+	};
+	/**
+	 * writes collections to out as Chrome trace events (JSON which chrome://tracing or Perfetto can open)
+	 *
+	 * Every collection is a complete event with the stats in its args, followed by counter events with the
+	 * heap size. The JSON array is closed by the destructor.
+	 */
+	class chrome_trace_writer : public gc_listener {
+	public:
+		explicit chrome_trace_writer(std::ostream &_out);
+		chrome_trace_writer(const chrome_trace_writer &) = delete;
+		~chrome_trace_writer() override;
+		void collection_end(const collection_stats &stats) override;
+	private:
+		std::ostream &out;
+		std::chrono::steady_clock::time_point origin;
+		bool first;
+	};
+}
+
+#endif
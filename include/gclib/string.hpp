@@ -0,0 +1,173 @@
+#ifndef GCLIB_STRING_HPP_
+#define GCLIB_STRING_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include "gc.hpp"
+
+namespace gclib {
+	/**
+	 * characters of a long or interned string, an immutable gc object with Header as its first field -
+	 * the characters (and a terminating zero) follow it
+	 */
+	struct string_data {
+		size_t header_magic;
+		uint32_t size;
+		uint32_t hash;
+		inline char *chars() { return reinterpret_cast<char *>(this + 1); }
+		inline std::string_view view() { return std::string_view(chars(), size); }
+	};
+	/// size of a string_data object, for the size callback - like bytes_vec_data
+	inline size_t bytes_string_data(void *data) { return sizeof(string_data) + static_cast<string_data *>(data)->size + 1; }
+	/// never 0, gclib::string uses that for a hash which isn't computed yet
+	inline uint32_t string_hash(std::string_view s) {
+		const uint64_t h = std::hash<std::string_view>()(s);
+		const uint32_t folded = static_cast<uint32_t>(h ^ (h >> 32));
+		return folded ? folded : 1;
+	}
+	/// allocates string_data holding s, which must not point into the gc heap
+	template<size_t Header, typename GC>
+	inline string_data *make_string_data(GC *gc, std::string_view s, uint32_t hash, void *pin) {
+		string_data *data = static_cast<string_data *>(gc->alloc_pinned(sizeof(string_data) + s.size() + 1, pin));
+		data->header_magic = Header;
+		data->size = static_cast<uint32_t>(s.size());
+		data->hash = hash;
+		std::memcpy(data->chars(), s.data(), s.size());
+		data->chars()[s.size()] = '\0';
+		return data;
+	}
+
+	/**
+	 * immutable string stored in a gc object, strings of up to small_capacity characters are kept inline
+	 * without allocating, longer ones in a string_data object - trace data_ref() (nullptr for small strings)
+	 *
+	 * Like vector, it has to live inside a gc object while assign() allocates. Copies share the data, but
+	 * storing a copy into a gc object needs a write barrier for data_ref() like any other reference. The
+	 * hash is computed once and cached.
+	 */
+	template<size_t Header, typename GC>
+	class string {
+	public:
+		static constexpr size_t small_capacity = 15;
+
+		inline string() : _size(0), _hash(0), _data(nullptr) { small[0] = '\0'; }
+		inline void assign(GC *gc, std::string_view s) {
+			if (s.size() <= small_capacity) {
+				gc->write_barrier_slot(&_data);
+				_data = nullptr;
+				std::memcpy(small, s.data(), s.size());
+				small[s.size()] = '\0';
+				_size = static_cast<uint32_t>(s.size());
+				_hash = 0;
+				return;
+			}
+			const std::string copy(s); // s may be the data of another string, which the allocation can move
+			const uint32_t hash = string_hash(copy);
+			string_data *data = make_string_data<Header>(gc, copy, hash, this);
+			gc->write_barrier_slot(&_data);
+			_data = data;
+			_size = data->size;
+			_hash = hash;
+		}
+		/// shares interned data (see string_interner) - small strings too, then it's only a pointer
+		inline void assign(GC *gc, string_data *interned) {
+			gc->write_barrier_slot(&_data);
+			_data = interned;
+			_size = interned->size;
+			_hash = interned->hash;
+		}
+		inline const char *c_str() const { return _data ? static_cast<string_data *>(_data)->chars() : small; }
+		inline std::string_view view() const { return std::string_view(c_str(), _size); }
+		inline size_t size() const { return _size; }
+		inline bool empty() const { return _size == 0; }
+		inline uint32_t hash() const {
+			if (_hash == 0) {
+				_hash = string_hash(view());
+			}
+			return _hash;
+		}
+		inline void **data_ref() { return &_data; }
+		inline bool operator==(const string &o) const {
+			if (_data && _data == o._data) {
+				return true;
+			}
+			if (_size != o._size || (_hash && o._hash && _hash != o._hash)) {
+				return false;
+			}
+			return view() == o.view();
+		}
+		inline bool operator==(std::string_view s) const { return view() == s; }
+	private:
+		uint32_t _size;
+		mutable uint32_t _hash;
+		void *_data;
+		char small[small_capacity + 1];
+	};
+
+	/**
+	 * weak set of string_data by content, one object per distinct string
+	 *
+	 * The strings are only referenced weakly, collections drop the ones nothing else refers to. Lives
+	 * outside of the gc heap and may only be used by one thread at a time.
+	 */
+	template<size_t Header, typename GC>
+	class string_interner : public weak_table {
+	public:
+		inline explicit string_interner(GC *_gc) : gc(_gc) { gc->add_weak_table(this); }
+		string_interner(const string_interner &) = delete;
+		inline ~string_interner() override { gc->remove_weak_table(this); }
+		/// the string_data with the characters of s, allocated if there's none yet
+		inline string_data *intern(std::string_view s) {
+			const uint32_t hash = string_hash(s);
+			const auto it = entries.find(entry { nullptr, hash, s });
+			if (it != entries.end()) {
+				gc->keep_alive(it->data);
+				return it->data;
+			}
+			const std::string copy(s); // s may be in the gc heap, which the allocation can move
+			string_data *data = make_string_data<Header>(gc, copy, hash, nullptr);
+			entries.insert(entry { data, hash, std::string_view() });
+			return data;
+		}
+		inline size_t size() const { return entries.size(); }
+		inline void sweep(live_fun live, void *context) override {
+			for (auto it = entries.begin(); it != entries.end();) {
+				void *moved = live(context, it->data);
+				if (moved == nullptr) {
+					it = entries.erase(it);
+					continue;
+				}
+				// the same characters, so the same hash and place in the set
+				const_cast<entry &>(*it).data = static_cast<string_data *>(moved);
+				++it;
+			}
+		}
+	private:
+		/// an interned string, or the characters looked up (with data == nullptr)
+		struct entry {
+			string_data *data;
+			uint32_t hash;
+			std::string_view lookup;
+			inline std::string_view view() const { return data ? data->view() : lookup; }
+		};
+		struct entry_hash {
+			inline size_t operator()(const entry &e) const { return e.hash; }
+		};
+		struct entry_equal {
+			inline bool operator()(const entry &a, const entry &b) const { return a.hash == b.hash && a.view() == b.view(); }
+		};
+		std::unordered_set<entry, entry_hash, entry_equal> entries;
+		GC *gc;
+	};
+}
+/// the cached hash, so gclib::string can be a key of gclib::hash_map
+template<size_t Header, typename GC>
+struct std::hash<gclib::string<Header, GC>> {
+	inline size_t operator()(const gclib::string<Header, GC> &s) const { return s.hash(); }
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <algorithm>
 #include <bit>
+#include <type_traits>
 
 namespace gclib {
 	/**
@@ -21,7 +22,17 @@ namespace gclib {
 	 * can even add an assertion in base object constructor that
 	 * reinterpret_cast<uintptr_t>(*this) != 0
 	 * to rely only on the fact that a virtual class takes up at least the space of one pointer)
+	 *
+	 * The vector calls the write barriers itself on push_back and when it replaces its data, so it has
+	 * to live inside a gc object. Writes through operator[] or at() need gc->write_barrier(*data_ref())
+	 * from the caller if T holds references.
+	 *
+	 * Growing extends the data in place when it's the last allocation (see basic_gc::try_extend) and
+	 * remaps the pages of big data (see basic_gc::try_resize_big), otherwise it allocates new data with
+	 * the holder pinned, so a collection can't move it meanwhile.
 	 */
+	template<typename T>
+	constexpr bool may_hold_refs = !std::is_arithmetic_v<T> && !std::is_enum_v<T>;
 	template<typename T, size_t Header, typename GC>
 	class vector {
 		size_t _size;
@@ -34,15 +45,16 @@ namespace gclib {
 		};
 
 		inline vector(GC *_gc) : _size(0), _data(nullptr), gc(_gc) { }
-		inline vector(const vector<T, Header, GC> &o) : _size(o._size), gc(o.gc) {
-			_data = alloc(o._size);
-			std::copy(o.begin(), o.end(), begin());
+		inline vector(const vector<T, Header, GC> &o) : _size(o._size), _data(nullptr), gc(o.gc) {
+			alloc(o._size);
+			std::copy(o.cbegin(), o.cend(), begin());
 		}
 		inline vector<T, Header, GC> &operator=(const vector<T, Header, GC> &o) {
 			gc = o.gc;
 			_size = o._size;
-			_data = alloc(o._size);
-			std::copy(o.begin(), o.end(), begin());
+			alloc(o._size);
+			std::copy(o.cbegin(), o.cend(), begin());
+			return *this;
 		}
 		inline T *data() {
 			return reinterpret_cast<T *>(reinterpret_cast<uint8_t *>(_data) + sizeof(data_header));
@@ -67,6 +79,7 @@ namespace gclib {
 					realloc(capacity() + capacity() / 2);
 				}
 			}
+			if constexpr (may_hold_refs<T>) gc->remember(_data);
 			new (&data()[_size++]) T(x);
 		}
 		inline void push_back(T &&x) {
@@ -77,6 +90,7 @@ namespace gclib {
 					realloc(capacity() + capacity() / 2);
 				}
 			}
+			if constexpr (may_hold_refs<T>) gc->remember(_data);
 			new (&data()[_size++]) T(std::forward<T>(x));
 		}
 		inline void pop_back() { _size--; }
@@ -104,13 +118,32 @@ namespace gclib {
 		}
 	private:
 		inline void alloc(size_t _capacity) {
-			_data = gc->alloc(sizeof(T) * _capacity + sizeof(data_header));
+			void *new_data = gc->alloc_pinned(sizeof(T) * _capacity + sizeof(data_header), this);
+			gc->write_barrier_slot(&_data);
+			_data = new_data;
 			header()->header_magic = Header;
 			header()->capacity = _capacity;
 		}
 		inline void realloc(size_t new_capacity) {
-			void *new_data = gc->alloc(sizeof(T) * new_capacity + sizeof(data_header));
+			if (new_capacity > capacity()) {
+				const size_t old_bytes = sizeof(T) * capacity() + sizeof(data_header);
+				const size_t new_bytes = sizeof(T) * new_capacity + sizeof(data_header);
+				if (gc->try_extend(_data, old_bytes, new_bytes)) {
+					header()->capacity = new_capacity;
+					return;
+				}
+				if (old_bytes > GC::geometry_type::big_object_treshold) {
+					if (void *moved = gc->try_resize_big(_data, new_bytes)) {
+						gc->write_barrier_slot(&_data);
+						_data = moved;
+						header()->capacity = new_capacity;
+						return;
+					}
+				}
+			}
+			void *new_data = gc->alloc_pinned(sizeof(T) * new_capacity + sizeof(data_header), this);
 			std::move(begin(), end(), reinterpret_cast<T *>(reinterpret_cast<uint8_t *>(new_data) + sizeof(data_header)));
+			gc->write_barrier_slot(&_data);
 			_data = new_data;
 			header()->header_magic = Header;
 			header()->capacity = new_capacity;
@@ -1,96 +1,94 @@
 #include <gclib/block.hpp>
 #include <cstdlib>
 #include <bit>
+#include <mutex>
+#include <new>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define GCLIB_MMAP_ARENAS
+#endif
 #include <gclib/params.hpp>
 
 namespace gclib {
-	constexpr size_t bytes_to_lines(size_t bytes) {
-		return (bytes + line_size-1) / line_size;
-	}
-	constexpr size_t metadata_lines = bytes_to_lines(sizeof(block));
-	static_assert(max_align <= line_size);
-
-	void block::clear() {
-		static_assert(metadata_lines < 64);
-		next_free = 0;
-		free[0] = 0xffffffffffffffffull << metadata_lines;
-		#pragma unroll
-		for (size_t i = 1; i < line_groups; i++) {
-			free[i] = 0xffffffffffffffffull;
-		}
-		//used_space = 0;
-	}
-	void block::prepare() {
-		next_free = 0;
-		while (next_free < line_groups && !free[next_free]) { next_free++; }
-	}
-	bool block::is_full() const {
-		return next_free == line_groups;
-	}
-	void block::next_range(void **begin, void **end) {
-		const size_t offset = std::countr_zero(free[next_free]);
-		*begin = reinterpret_cast<uint8_t *>(this) + (64*next_free + offset) * line_size;
-		uint64_t free_end = free[next_free] + (1ull << offset);
-		if (free_end == 0) { // overflow into next line group
-			do {
-				free[next_free++] = 0;
-			} while (next_free < line_groups && free[next_free] == 0xffffffffffffffffull);
-			if (next_free == line_groups) { // rest of the block is free
-				*end = reinterpret_cast<uint8_t *>(this) + block_size;
-				return;
+	namespace {
+		/**
+		 * carves blocks of one size from big block-aligned arenas and keeps freed blocks for reuse
+		 *
+		 * Shared by all gc instances. Arenas are mapped once and live until the process exits.
+		 */
+		class block_space {
+		public:
+			void *take(size_t block_bytes) {
+				std::lock_guard lock(mutex);
+				if (recycled) {
+					free_link *out = recycled;
+					recycled = out->next;
+					return out;
+				}
+				if (arena_next == arena_end) {
+					arena_next = map_arena(block_bytes);
+					arena_end = arena_next + block_arena_blocks * block_bytes;
+				}
+				void *out = arena_next;
+				arena_next += block_bytes;
+				return out;
 			}
-			free_end = free[next_free] + 1;
-		}
-		const size_t offset_end = std::countr_zero(free_end);
-		*end = reinterpret_cast<uint8_t *>(this) + (64*next_free + offset_end) * line_size;
-		free[next_free] = free_end & (free_end - 1);
-		while (next_free < line_groups && !free[next_free]) { next_free++; }
-	}
-	void block::add_object(void *at, size_t bytes) {
-		//used_space += bytes;
-		const size_t first_line = (reinterpret_cast<uint8_t *>(at) - reinterpret_cast<uint8_t *>(this)) / line_size;
-		const size_t last_line = (reinterpret_cast<uint8_t *>(at) + bytes - 1 - reinterpret_cast<uint8_t *>(this)) / line_size;
-		const size_t first_line_group = first_line / 64;
-		const size_t last_line_group = last_line / 64;
-		const size_t first_line_group_part = first_line % 64;
-		const size_t last_line_group_part = last_line % 64;
-		for (size_t i = first_line_group + 1; i < last_line_group; i++) {
-			free[i] = 0;
-		}
-		if (first_line_group == last_line_group) {
-			uint64_t mask = first_line_group_part == 0 ? 0 :
-				0xffffffffffffffffull >> (64 - first_line_group_part);
-			mask |= last_line_group_part == 63 ? 0 :
-				0xffffffffffffffffull << (last_line_group_part + 1);
-			free[first_line_group] &= mask;
-		} else {
-			free[first_line_group] &= first_line_group_part == 0 ? 0 :
-				0xffffffffffffffffull >> (64 - first_line_group_part);
-			free[last_line_group] &= last_line_group_part == 63 ? 0 :
-				0xffffffffffffffffull << (last_line_group_part + 1);
-		}
-	}
-	size_t block::count_holes() const {
-		size_t holes = 0;
-		for (size_t i = 0; i < line_groups; i++) {
-			holes += std::popcount(~free[i] & (free[i] >> 1));
-			if (i && (free[i-1] >> 63) == 0 && (free[i] & 1) == 1) {
-				holes++;
+			void give_back(void *b) {
+				std::lock_guard lock(mutex);
+				free_link *link = reinterpret_cast<free_link *>(b);
+				link->next = recycled;
+				recycled = link;
 			}
-		}
-		return holes;
-	}
+		private:
+			struct free_link {
+				free_link *next;
+			};
+			std::mutex mutex;
+			free_link *recycled = nullptr;
+			uint8_t *arena_next = nullptr;
+			uint8_t *arena_end = nullptr;
 
-	block *alloc_block() {
-		block *out = (block *)std::aligned_alloc(block_size, block_size);
-		out->clear();
-		return out;
+			static uint8_t *map_arena(size_t block_bytes) {
+				const size_t block_arena_size = block_arena_blocks * block_bytes;
+#ifdef GCLIB_MMAP_ARENAS
+				// mmap only guarantees page alignment, so map more and cut off the unaligned ends
+				const size_t alignment = block_arena_huge_pages ? block_arena_size : block_bytes;
+				const size_t mapped_size = block_arena_size + alignment;
+				void *mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (mapped == MAP_FAILED) {
+					throw std::bad_alloc();
+				}
+				uint8_t *begin = static_cast<uint8_t *>(mapped);
+				uint8_t *out = reinterpret_cast<uint8_t *>((reinterpret_cast<uintptr_t>(begin) + alignment - 1) & ~(alignment - 1));
+				if (out != begin) {
+					munmap(begin, out - begin);
+				}
+				if (out + block_arena_size != begin + mapped_size) {
+					munmap(out + block_arena_size, begin + mapped_size - (out + block_arena_size));
+				}
+#ifdef MADV_HUGEPAGE
+				if constexpr (block_arena_huge_pages) {
+					madvise(out, block_arena_size, MADV_HUGEPAGE);
+				}
+#endif
+				return out;
+#else
+				void *out = std::aligned_alloc(block_bytes, block_arena_size);
+				if (out == nullptr) {
+					throw std::bad_alloc();
+				}
+				return static_cast<uint8_t *>(out);
+#endif
+			}
+		};
+		/// one space per block size, indexed by its log2
+		block_space spaces[64];
 	}
-	void free_block(block *b) {
-		std::free(b);
+
+	void *alloc_block_memory(size_t block_bytes) {
+		return spaces[std::countr_zero(block_bytes)].take(block_bytes);
 	}
-	block *obj_block(void *obj) {
-		return reinterpret_cast<block *>(reinterpret_cast<std::uintptr_t>(obj) & ~(block_size - 1));
+	void free_block_memory(void *memory, size_t block_bytes) {
+		spaces[std::countr_zero(block_bytes)].give_back(memory);
 	}
 }
-
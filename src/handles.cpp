@@ -0,0 +1,17 @@
+#include <gclib/handles.hpp>
+
+namespace gclib {
+	handle_stack::handle_stack() : chunk(0) {
+		chunks.push_back(std::make_unique<void *[]>(handle_chunk_size));
+		top = chunks[0].get();
+		limit = top + handle_chunk_size;
+	}
+	void handle_stack::next_chunk() {
+		chunk++;
+		if (chunk == chunks.size()) {
+			chunks.push_back(std::make_unique<void *[]>(handle_chunk_size));
+		}
+		top = chunks[chunk].get();
+		limit = top + handle_chunk_size;
+	}
+}
@@ -0,0 +1,167 @@
+#include <gclib/large.hpp>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <gclib/params.hpp>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define GCLIB_MMAP_RUNS
+#endif
+#ifdef __linux__
+#define GCLIB_MREMAP_RUNS
+#endif
+
+namespace gclib {
+	namespace {
+		size_t page_size() {
+#ifdef GCLIB_MMAP_RUNS
+			static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			return size;
+#else
+			return 4096;
+#endif
+		}
+		void *map_run(size_t bytes) {
+#ifdef GCLIB_MMAP_RUNS
+			void *out = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (out == MAP_FAILED) {
+				throw std::bad_alloc();
+			}
+			return out;
+#else
+			void *out = std::aligned_alloc(page_size(), bytes);
+			if (out == nullptr) {
+				throw std::bad_alloc();
+			}
+			return out;
+#endif
+		}
+		void unmap_run(void *run, size_t bytes) {
+#ifdef GCLIB_MMAP_RUNS
+			munmap(run, bytes);
+#else
+			(void)bytes;
+			std::free(run);
+#endif
+		}
+
+		/// freed page runs by size, kept below large_object_cache_size bytes in total
+		class run_cache {
+		public:
+			/// returns a cached run of at least bytes (and not much more), or nullptr
+			void *take(size_t bytes, size_t &run_bytes) {
+				std::lock_guard lock(mutex);
+				auto it = runs.lower_bound(bytes);
+				if (it == runs.end() || it->first > bytes + bytes / 4) {
+					return nullptr;
+				}
+				void *out = it->second.back();
+				run_bytes = it->first;
+				it->second.pop_back();
+				if (it->second.empty()) {
+					runs.erase(it);
+				}
+				cached_bytes -= run_bytes;
+				return out;
+			}
+			void give_back(void *run, size_t bytes) {
+				{
+					std::lock_guard lock(mutex);
+					if (cached_bytes + bytes <= large_object_cache_size) {
+						runs[bytes].push_back(run);
+						cached_bytes += bytes;
+						return;
+					}
+				}
+				unmap_run(run, bytes);
+			}
+		private:
+			std::mutex mutex;
+			std::map<size_t, std::vector<void *>> runs;
+			size_t cached_bytes = 0;
+		};
+		run_cache cache;
+
+		void free_run(big_object_header *header) {
+			cache.give_back(header, header->run_bytes);
+		}
+	}
+
+	big_object_header *big_object_header_of(void *obj) {
+		return reinterpret_cast<big_object_header *>(reinterpret_cast<uint8_t *>(obj) - big_object_header_size);
+	}
+
+	large_object_space::large_object_space() : head(nullptr), count(0) { }
+	large_object_space::~large_object_space() {
+		for (big_object_header *h = head; h; ) {
+			big_object_header *next = h->next;
+			free_run(h);
+			h = next;
+		}
+	}
+	void *large_object_space::alloc(size_t bytes) {
+		const size_t page = page_size();
+		size_t run_bytes = (big_object_header_size + bytes + page - 1) / page * page;
+		void *run = cache.take(run_bytes, run_bytes);
+		if (run == nullptr) {
+			run = map_run(run_bytes);
+		}
+		big_object_header *header = static_cast<big_object_header *>(run);
+		header->prev = nullptr;
+		header->next = head;
+		header->run_bytes = run_bytes;
+		header->mark = 0;
+		header->remembered = 0;
+		if (head) {
+			head->prev = header;
+		}
+		head = header;
+		count++;
+		return reinterpret_cast<uint8_t *>(header) + big_object_header_size;
+	}
+	void *large_object_space::resize(void *obj, size_t bytes) {
+		big_object_header *header = big_object_header_of(obj);
+		const size_t page = page_size();
+		const size_t run_bytes = (big_object_header_size + bytes + page - 1) / page * page;
+		if (run_bytes <= header->run_bytes) {
+			return obj;
+		}
+#ifdef GCLIB_MREMAP_RUNS
+		void *run = mremap(header, header->run_bytes, run_bytes, MREMAP_MAYMOVE);
+		if (run == MAP_FAILED) {
+			return nullptr;
+		}
+		header = static_cast<big_object_header *>(run);
+		header->run_bytes = run_bytes;
+		(header->prev ? header->prev->next : head) = header;
+		if (header->next) {
+			header->next->prev = header;
+		}
+		return reinterpret_cast<uint8_t *>(header) + big_object_header_size;
+#else
+		return nullptr;
+#endif
+	}
+	void large_object_space::sweep() {
+		for (big_object_header *h = head; h; ) {
+			big_object_header *next = h->next;
+			if (!h->mark) {
+				(h->prev ? h->prev->next : head) = next;
+				if (next) {
+					next->prev = h->prev;
+				}
+				free_run(h);
+				count--;
+			}
+			h = next;
+		}
+	}
+	void large_object_space::clear_marks() {
+		for (big_object_header *h = head; h; h = h->next) {
+			h->mark = 0;
+		}
+	}
+}
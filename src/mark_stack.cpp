@@ -0,0 +1,22 @@
+#include <gclib/mark_stack.hpp>
+
+namespace gclib {
+	mark_stack::mark_stack() : segment(0) {
+		segments.push_back(std::make_unique<void *[]>(mark_segment_entries));
+		base = top = segments[0].get();
+		limit = base + mark_segment_entries;
+	}
+	void mark_stack::next_segment() {
+		segment++;
+		if (segment == segments.size()) {
+			segments.push_back(std::make_unique<void *[]>(mark_segment_entries));
+		}
+		base = top = segments[segment].get();
+		limit = base + mark_segment_entries;
+	}
+	void mark_stack::previous_segment() {
+		segment--;
+		base = segments[segment].get();
+		top = limit = base + mark_segment_entries;
+	}
+}
@@ -0,0 +1,120 @@
+#include <gclib/parallel.hpp>
+
+namespace gclib {
+	constexpr size_t initial_deque_capacity = 1024;
+
+	work_stealing_deque::buffer::buffer(size_t _capacity) :
+		capacity(_capacity), items(new std::atomic<void *>[_capacity]) { }
+
+	work_stealing_deque::work_stealing_deque() : top(0), bottom(0) {
+		buffers.push_back(std::make_unique<buffer>(initial_deque_capacity));
+		items.store(buffers.back().get(), std::memory_order_relaxed);
+	}
+	work_stealing_deque::~work_stealing_deque() { }
+	void work_stealing_deque::push(void *item) {
+		const int64_t b = bottom.load(std::memory_order_relaxed);
+		const int64_t t = top.load(std::memory_order_acquire);
+		buffer *buf = items.load(std::memory_order_relaxed);
+		if (b - t > static_cast<int64_t>(buf->capacity) - 1) {
+			buffers.push_back(std::make_unique<buffer>(buf->capacity * 2));
+			for (int64_t i = t; i < b; i++) {
+				buffers.back()->put(i, buf->get(i));
+			}
+			buf = buffers.back().get();
+			items.store(buf, std::memory_order_release);
+		}
+		buf->put(b, item);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	void *work_stealing_deque::pop() {
+		const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		buffer *buf = items.load(std::memory_order_relaxed);
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+		if (t > b) {
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		void *item = buf->get(b);
+		if (t == b) { // last item, race against thieves
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				item = nullptr;
+			}
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return item;
+	}
+	void *work_stealing_deque::steal() {
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b) {
+			return nullptr;
+		}
+		void *item = items.load(std::memory_order_acquire)->get(t);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return nullptr;
+		}
+		return item;
+	}
+	bool work_stealing_deque::empty() const {
+		return top.load(std::memory_order_acquire) >= bottom.load(std::memory_order_acquire);
+	}
+	void work_stealing_deque::reset() {
+		buffer *buf = items.load(std::memory_order_relaxed);
+		std::erase_if(buffers, [buf](const std::unique_ptr<buffer> &b) { return b.get() != buf; });
+	}
+
+	worker_pool::worker_pool(size_t workers) : task(nullptr), generation(0), running(0), stopping(false) {
+		for (size_t i = 1; i < workers; i++) {
+			threads.emplace_back(&worker_pool::worker, this, i);
+		}
+	}
+	worker_pool::~worker_pool() {
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		start_cv.notify_all();
+		for (std::thread &t : threads) {
+			t.join();
+		}
+	}
+	void worker_pool::run(const std::function<void (size_t)> &_task) {
+		{
+			std::lock_guard lock(mutex);
+			task = &_task;
+			running = threads.size();
+			generation++;
+		}
+		start_cv.notify_all();
+		_task(0);
+		std::unique_lock lock(mutex);
+		done_cv.wait(lock, [this]() { return running == 0; });
+		task = nullptr;
+	}
+	void worker_pool::worker(size_t id) {
+		uint64_t seen_generation = 0;
+		while (true) {
+			const std::function<void (size_t)> *current;
+			{
+				std::unique_lock lock(mutex);
+				start_cv.wait(lock, [&]() { return stopping || generation != seen_generation; });
+				if (stopping) {
+					return;
+				}
+				seen_generation = generation;
+				current = task;
+			}
+			(*current)(id);
+			{
+				std::lock_guard lock(mutex);
+				running--;
+			}
+			done_cv.notify_one();
+		}
+	}
+}
+
@@ -0,0 +1,234 @@
+#include <gclib/snapshot.hpp>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace gclib {
+	snapshot_writer::snapshot_writer(std::ostream &_out, uint32_t line_size, uint32_t block_size, uint64_t big_object_treshold) : out(_out) {
+		out.write(snapshot_magic, sizeof(snapshot_magic));
+		u32(line_size);
+		u32(block_size);
+		u64(big_object_treshold);
+	}
+	void snapshot_writer::section(uint64_t count) {
+		u64(count);
+	}
+	void snapshot_writer::block(const void *address, const uint64_t *lines, size_t line_groups) {
+		u64(reinterpret_cast<uintptr_t>(address));
+		for (size_t i = 0; i < line_groups; i++) {
+			u64(lines[i]);
+		}
+	}
+	void snapshot_writer::root(void *const *slot, const void *obj) {
+		u64(reinterpret_cast<uintptr_t>(slot));
+		u64(reinterpret_cast<uintptr_t>(obj));
+	}
+	void snapshot_writer::object(const void *address, uint64_t size, uint32_t tag, uint32_t ref_count) {
+		u64(reinterpret_cast<uintptr_t>(address));
+		u64(size);
+		u32(tag);
+		u32(ref_count);
+	}
+	void snapshot_writer::ref(const void *target) {
+		u64(reinterpret_cast<uintptr_t>(target));
+	}
+	void snapshot_writer::u32(uint32_t x) {
+		char bytes[4];
+		for (size_t i = 0; i < 4; i++) {
+			bytes[i] = static_cast<char>(x >> (8*i));
+		}
+		out.write(bytes, 4);
+	}
+	void snapshot_writer::u64(uint64_t x) {
+		char bytes[8];
+		for (size_t i = 0; i < 8; i++) {
+			bytes[i] = static_cast<char>(x >> (8*i));
+		}
+		out.write(bytes, 8);
+	}
+
+	namespace {
+		uint64_t read_le(std::istream &in, size_t bytes) {
+			unsigned char buffer[8];
+			if (!in.read(reinterpret_cast<char *>(buffer), bytes)) {
+				throw std::runtime_error("truncated heap snapshot");
+			}
+			uint64_t x = 0;
+			for (size_t i = 0; i < bytes; i++) {
+				x |= static_cast<uint64_t>(buffer[i]) << (8*i);
+			}
+			return x;
+		}
+		uint64_t read_u64(std::istream &in) { return read_le(in, 8); }
+		uint32_t read_u32(std::istream &in) { return static_cast<uint32_t>(read_le(in, 4)); }
+		/// a count which can't be more than the rest of the stream, so a broken one doesn't allocate too much
+		uint64_t read_count(std::istream &in, uint64_t element_bytes) {
+			const uint64_t count = read_u64(in);
+			const std::streampos here = in.tellg();
+			if (here != std::streampos(-1)) {
+				in.seekg(0, std::ios::end);
+				const uint64_t left = static_cast<uint64_t>(in.tellg() - here);
+				in.seekg(here);
+				if (count > left / element_bytes) {
+					throw std::runtime_error("broken heap snapshot");
+				}
+			}
+			return count;
+		}
+	}
+	heap_snapshot heap_snapshot::read(std::istream &in) {
+		heap_snapshot out;
+		char magic[sizeof(snapshot_magic)];
+		if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, snapshot_magic, sizeof(magic)) != 0) {
+			throw std::runtime_error("not a heap snapshot");
+		}
+		out.line_size = read_u32(in);
+		out.block_size = read_u32(in);
+		out.big_object_treshold = read_u64(in);
+		if (out.line_size == 0 || out.block_size % (64 * out.line_size) != 0) {
+			throw std::runtime_error("broken heap snapshot");
+		}
+		const size_t line_groups = out.block_size / out.line_size / 64;
+		out.blocks.resize(read_count(in, 8 * (1 + line_groups)));
+		for (block &b : out.blocks) {
+			b.address = read_u64(in);
+			b.lines.resize(line_groups);
+			for (uint64_t &group : b.lines) {
+				group = read_u64(in);
+			}
+		}
+		out.roots.resize(read_count(in, 16));
+		for (root &r : out.roots) {
+			r.slot = read_u64(in);
+			r.object = read_u64(in);
+		}
+		out.objects.resize(read_count(in, 24));
+		for (object &o : out.objects) {
+			o.address = read_u64(in);
+			o.size = read_u64(in);
+			o.tag = read_u32(in);
+			const uint32_t ref_count = read_u32(in);
+			for (uint32_t i = 0; i < ref_count; i++) { // no reserve, a broken count runs into the end of the stream instead
+				o.refs.push_back(read_u64(in));
+			}
+		}
+		std::sort(out.objects.begin(), out.objects.end(), [](const object &a, const object &b) {
+			return a.address < b.address;
+		});
+		return out;
+	}
+	size_t heap_snapshot::find(uint64_t address) const {
+		const auto it = std::lower_bound(objects.begin(), objects.end(), address, [](const object &o, uint64_t a) {
+			return o.address < a;
+		});
+		return it != objects.end() && it->address == address ? it - objects.begin() : objects.size();
+	}
+	std::vector<size_t> heap_snapshot::dominators() const {
+		// the iterative algorithm of Cooper, Harvey and Kennedy, with the roots as one extra node
+		const size_t n = objects.size();
+		const size_t undefined = n + 1;
+		std::vector<std::vector<size_t>> successors(n + 1);
+		std::vector<std::vector<size_t>> predecessors(n + 1);
+		const auto edge = [&](size_t from, uint64_t address) {
+			const size_t to = find(address);
+			if (to != n) {
+				successors[from].push_back(to);
+				predecessors[to].push_back(from);
+			}
+		};
+		for (const root &r : roots) {
+			edge(n, r.object);
+		}
+		for (size_t i = 0; i < n; i++) {
+			for (uint64_t ref : objects[i].refs) {
+				edge(i, ref);
+			}
+		}
+		// postorder numbers from an explicit stack dfs, object graphs are often deeper than the call stack
+		std::vector<size_t> postorder_number(n + 1, undefined);
+		std::vector<size_t> reverse_postorder;
+		{
+			std::vector<bool> visited(n + 1, false);
+			std::vector<std::pair<size_t, size_t>> stack { { n, 0 } };
+			visited[n] = true;
+			while (!stack.empty()) {
+				auto &[node, next] = stack.back();
+				if (next < successors[node].size()) {
+					const size_t to = successors[node][next++];
+					if (!visited[to]) {
+						visited[to] = true;
+						stack.push_back({ to, 0 });
+					}
+					continue;
+				}
+				postorder_number[node] = reverse_postorder.size();
+				reverse_postorder.push_back(node);
+				stack.pop_back();
+			}
+			std::reverse(reverse_postorder.begin(), reverse_postorder.end());
+		}
+		std::vector<size_t> idom(n + 1, undefined);
+		idom[n] = n;
+		const auto intersect = [&](size_t a, size_t b) {
+			while (a != b) {
+				while (postorder_number[a] < postorder_number[b]) {
+					a = idom[a];
+				}
+				while (postorder_number[b] < postorder_number[a]) {
+					b = idom[b];
+				}
+			}
+			return a;
+		};
+		for (bool changed = true; changed;) {
+			changed = false;
+			for (size_t node : reverse_postorder) {
+				if (node == n) {
+					continue;
+				}
+				size_t new_idom = undefined;
+				for (size_t p : predecessors[node]) {
+					if (idom[p] != undefined) {
+						new_idom = new_idom == undefined ? p : intersect(p, new_idom);
+					}
+				}
+				if (idom[node] != new_idom) {
+					idom[node] = new_idom;
+					changed = true;
+				}
+			}
+		}
+		idom.pop_back();
+		for (size_t &d : idom) {
+			if (d == undefined) {
+				d = n;
+			}
+		}
+		return idom;
+	}
+	std::vector<uint64_t> heap_snapshot::retained_sizes() const {
+		const std::vector<size_t> idom = dominators();
+		std::vector<uint64_t> retained(objects.size());
+		std::vector<std::vector<size_t>> children(objects.size());
+		std::vector<size_t> tops;
+		for (size_t i = 0; i < objects.size(); i++) {
+			retained[i] = objects[i].size;
+			(idom[i] == objects.size() ? tops : children[idom[i]]).push_back(i);
+		}
+		// children before their dominators
+		std::vector<size_t> order;
+		std::vector<size_t> stack = tops;
+		while (!stack.empty()) {
+			const size_t node = stack.back();
+			stack.pop_back();
+			order.push_back(node);
+			stack.insert(stack.end(), children[node].begin(), children[node].end());
+		}
+		for (auto it = order.rbegin(); it != order.rend(); ++it) {
+			if (idom[*it] != objects.size()) {
+				retained[idom[*it]] += retained[*it];
+			}
+		}
+		return retained;
+	}
+}
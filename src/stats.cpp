@@ -0,0 +1,65 @@
+#include <gclib/stats.hpp>
+#include <iomanip>
+
+namespace gclib {
+	const char *collection_kind_name(collection_kind kind) {
+		switch (kind) {
+		case collection_kind::full: return "full";
+		case collection_kind::minor: return "minor";
+		case collection_kind::concurrent: return "concurrent";
+		case collection_kind::incremental: return "incremental";
+		}
+		return "unknown";
+	}
+
+	namespace {
+		double micros(std::chrono::steady_clock::duration d) {
+			return std::chrono::duration<double, std::micro>(d).count();
+		}
+	}
+	chrome_trace_writer::chrome_trace_writer(std::ostream &_out) : out(_out), origin(std::chrono::steady_clock::now()), first(true) {
+		out << "[";
+	}
+	chrome_trace_writer::~chrome_trace_writer() {
+		out << "\n]\n";
+		out.flush();
+	}
+	void chrome_trace_writer::collection_end(const collection_stats &stats) {
+		const std::ios_base::fmtflags flags = out.flags();
+		const std::streamsize precision = out.precision();
+		out << std::fixed << std::setprecision(3);
+		const double ts = micros(stats.start - origin);
+		out << (first ? "\n" : ",\n");
+		first = false;
+		out << "{\"name\":\"" << collection_kind_name(stats.kind) << " collection\",\"cat\":\"gc\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+			<< ",\"ts\":" << ts << ",\"dur\":" << micros(stats.end - stats.start)
+			<< ",\"args\":{\"number\":" << stats.number
+			<< ",\"pause_us\":" << micros(stats.pause)
+			<< ",\"root_scan_us\":" << micros(stats.phases.root_scan)
+			<< ",\"mark_us\":" << micros(stats.phases.mark)
+			<< ",\"big_sweep_us\":" << micros(stats.phases.big_sweep)
+			<< ",\"evacuation_us\":" << micros(stats.phases.evacuation)
+			<< ",\"prepare_us\":" << micros(stats.phases.prepare)
+			<< ",\"allocated_bytes\":" << stats.allocated_bytes
+			<< ",\"marked_bytes\":" << stats.marked_bytes
+			<< ",\"marked_objects\":" << stats.marked_objects
+			<< ",\"evacuated_bytes\":" << stats.evacuated_bytes
+			<< ",\"evacuated_objects\":" << stats.evacuated_objects
+			<< ",\"hole_histogram\":[";
+		for (size_t i = 0; i < hole_histogram_buckets; i++) {
+			out << (i ? "," : "") << stats.hole_histogram[i];
+		}
+		out << "],\"live_histogram\":[";
+		for (size_t i = 0; i < live_histogram_buckets; i++) {
+			out << (i ? "," : "") << stats.live_histogram[i];
+		}
+		out << "]}},\n";
+		const double end_ts = micros(stats.end - origin);
+		out << "{\"name\":\"heap\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":" << end_ts
+			<< ",\"args\":{\"blocks\":" << stats.blocks << ",\"big_objects\":" << stats.big_objects << "}},\n";
+		out << "{\"name\":\"live bytes\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":" << end_ts
+			<< ",\"args\":{\"bytes\":" << stats.marked_bytes << "}}";
+		out.flags(flags);
+		out.precision(precision);
+	}
+}
@@ -0,0 +1,285 @@
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <gclib/gc.hpp>
+#include <gclib/hash_map.hpp>
+#include <gclib/string.hpp>
+
+namespace containers_test {
+	enum tag : uint8_t { tag_node, tag_map, tag_map_data, tag_names, tag_string_data, tag_link };
+	struct node {
+		tag t;
+		int64_t value;
+		node(int64_t v) : t(tag_node), value(v) { }
+	};
+	/// a chain of these makes the marker reach what's at its end late
+	struct chain_link {
+		tag t;
+		void *next;
+		chain_link(void *n) : t(tag_link), next(n) { }
+	};
+	struct policy {
+		static size_t size(void *obj);
+		template<typename Visitor>
+		static void trace(void *obj, Visitor &visit);
+	};
+	using test_gc = gclib::basic_gc<policy>;
+	constexpr size_t map_data_header = gclib::make_header(tag_map_data);
+	struct map_holder {
+		tag t;
+		gclib::hash_map<int64_t, node *, map_data_header, test_gc> map;
+		map_holder(test_gc *gc) : t(tag_map), map(gc) { }
+	};
+	constexpr size_t string_data_header = gclib::make_header(tag_string_data);
+	using gcstring = gclib::string<string_data_header, test_gc>;
+	struct names {
+		tag t;
+		gcstring first;
+		gcstring second;
+		names() : t(tag_names) { }
+	};
+	size_t policy::size(void *obj) {
+		switch (*(tag *)obj) {
+		case tag_node: return sizeof(node);
+		case tag_map: return sizeof(map_holder);
+		case tag_map_data: return gclib::bytes_hash_map_data<int64_t, node *>(obj);
+		case tag_names: return sizeof(names);
+		case tag_string_data: return gclib::bytes_string_data(obj);
+		case tag_link: return sizeof(chain_link);
+		}
+		return sizeof(tag);
+	}
+	template<typename Visitor>
+	void policy::trace(void *obj, Visitor &visit) {
+		switch (*(tag *)obj) {
+		case tag_map:
+			visit(((map_holder *)obj)->map.data_ref());
+			visit(((map_holder *)obj)->map.old_data_ref());
+			break;
+		case tag_map_data:
+			gclib::for_each_hash_map_entry<int64_t, node *>(obj, [&](int64_t, node *&value) { visit(reinterpret_cast<void **>(&value)); });
+			break;
+		case tag_names:
+			visit(((names *)obj)->first.data_ref());
+			visit(((names *)obj)->second.data_ref());
+			break;
+		case tag_link:
+			visit(&((chain_link *)obj)->next);
+			break;
+		case tag_node:
+		case tag_string_data:
+			break;
+		}
+	}
+
+	/// random inserts, assignments and erases, checked against std::unordered_map
+	void churn(test_gc &gc, test_gc::unique_root_type<map_holder> &m, std::unordered_map<int64_t, int64_t> &expected, std::mt19937 &rng, int ops) {
+		std::uniform_int_distribution<int64_t> keys(0, 40'000);
+		for (int i = 0; i < ops; i++) {
+			const int64_t key = keys(rng);
+			switch (rng() % 4) {
+			case 0:
+			case 1: {
+				node *n = gc.new_<node>(key * 3 + i);
+				m->map.insert_or_assign(key, n);
+				expected[key] = key * 3 + i;
+				break;
+			}
+			case 2: {
+				node *n = gc.new_<node>(key);
+				REQUIRE(m->map.insert(key, n) == !expected.contains(key));
+				expected.emplace(key, key);
+				break;
+			}
+			case 3:
+				REQUIRE(m->map.erase(key) == (expected.erase(key) == 1));
+				break;
+			}
+		}
+	}
+	struct evacuation_counter : gclib::gc_listener {
+		uint64_t evacuated = 0;
+		void collection_end(const gclib::collection_stats &stats) override { evacuated += stats.evacuated_objects; }
+	};
+	void check(map_holder *m, const std::unordered_map<int64_t, int64_t> &expected) {
+		REQUIRE(m->map.size() == expected.size());
+		for (const auto &[key, value] : expected) {
+			node **n = m->map.find(key);
+			REQUIRE(n != nullptr);
+			REQUIRE((*n)->value == value);
+		}
+		size_t visited = 0;
+		m->map.for_each([&](int64_t key, node *n) {
+			REQUIRE(expected.at(key) == n->value);
+			visited++;
+		});
+		REQUIRE(visited == expected.size());
+	}
+}
+using namespace containers_test;
+
+TEST_CASE("hash map") {
+	test_gc gc;
+	gclib::gc_config config;
+	config.min_heap_bytes = 256 * 1024;
+	gc.set_config(config);
+	evacuation_counter evacuations;
+	gc.set_listener(&evacuations);
+	std::mt19937 rng(7);
+	std::unordered_map<int64_t, int64_t> expected;
+	test_gc::unique_root_type<map_holder> m = gc.make_unique<map_holder>(&gc);
+	REQUIRE(m->map.find(1) == nullptr);
+	REQUIRE_FALSE(m->map.erase(1));
+
+	bool saw_old_table = false;
+	for (int64_t i = 0; i < 5'000; i++) {
+		node *n = gc.new_<node>(i);
+		m->map.insert(i, n);
+		expected[i] = i;
+		saw_old_table |= *m->map.old_data_ref() != nullptr;
+	}
+	REQUIRE(saw_old_table); // growth is incremental
+	check(m.get(), expected);
+
+	churn(gc, m, expected, rng, 200'000);
+	gc.collect();
+	REQUIRE(evacuations.evacuated > 0);
+	check(m.get(), expected);
+	REQUIRE(gc.live_object_count() == expected.size() + 2 + (*m->map.old_data_ref() != nullptr));
+
+	gc.set_generational(true);
+	gc.collect();
+	churn(gc, m, expected, rng, 300'000);
+	REQUIRE(gc.minor_collection_count() > 0);
+	check(m.get(), expected);
+
+	gc.set_generational(false);
+	gc.collect();
+	gc.start_concurrent_collect();
+	churn(gc, m, expected, rng, 20'000);
+	gc.finish_concurrent_collect();
+	gc.collect();
+	check(m.get(), expected);
+
+	m->map.clear();
+	expected.clear();
+	gc.collect();
+	REQUIRE(m->map.empty());
+	REQUIRE(gc.live_object_count() == 2);
+	m->map.reserve(10'000);
+	const size_t reserved = m->map.capacity();
+	churn(gc, m, expected, rng, 5'000);
+	REQUIRE(m->map.capacity() == reserved);
+	check(m.get(), expected);
+}
+
+TEST_CASE("hash map grows while marking") {
+	test_gc gc;
+	gclib::gc_config config;
+	config.min_heap_bytes = 64 * 1024 * 1024; // only the collections below
+	gc.set_config(config);
+	std::unordered_map<int64_t, int64_t> expected;
+	test_gc::unique_root_type<chain_link> head = gc.make_unique<chain_link>(nullptr);
+	{
+		test_gc::unique_root_type<map_holder> m = gc.make_unique<map_holder>(&gc);
+		for (int64_t i = 0; i < 3'000; i++) {
+			node *n = gc.new_<node>(i);
+			m->map.insert(i, n);
+			expected[i] = i;
+		}
+		m->map.reserve(0); // no growth running
+		head->next = m.get();
+	}
+	for (int i = 0; i < 20'000; i++) {
+		chain_link *l = gc.new_<chain_link>(head.get());
+		head = test_gc::unique_root_type<chain_link>(l, &gc);
+	}
+	const auto holder = [&head]() {
+		void *o = head.get();
+		while (*static_cast<tag *>(o) == tag_link) {
+			o = static_cast<chain_link *>(o)->next;
+		}
+		return static_cast<map_holder *>(o);
+	};
+	map_holder *m = holder(); // nothing moves until the collection ends, it doesn't evacuate
+	REQUIRE(*m->map.old_data_ref() == nullptr);
+	REQUIRE_FALSE(gc.collect_step(std::chrono::microseconds(0))); // marks the start of the chain only
+	bool migrated = false;
+	for (int64_t i = 3'000; !migrated; i++) {
+		const bool growing = *m->map.old_data_ref() != nullptr;
+		node *n = gc.new_<node>(i);
+		m->map.insert(i, n);
+		expected[i] = i;
+		migrated = growing && *m->map.old_data_ref() == nullptr;
+	}
+	REQUIRE(gc.concurrent_collect_running()); // the whole old table moved before the marker got to it
+	gc.finish_concurrent_collect();
+	for (int i = 0; i < 100'000; i++) {
+		gc.new_<node>(-1); // reuses the lines of anything that wasn't marked
+	}
+	gc.collect();
+	check(holder(), expected);
+}
+
+TEST_CASE("strings") {
+	test_gc gc;
+	test_gc::unique_root_type<names> n = gc.make_unique<names>();
+	n->first.assign(&gc, "short");
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 1); // kept inline
+	REQUIRE(n->first == std::string_view("short"));
+	REQUIRE(n->first.hash() == gclib::string_hash("short"));
+	const std::string text(100, 'x');
+	n->second.assign(&gc, text);
+	n->first.assign(&gc, n->second.view());
+	REQUIRE(n->first == n->second);
+	REQUIRE(std::string(n->first.c_str()) == text);
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 3);
+	n->second.assign(&gc, "");
+	REQUIRE(n->second.empty());
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 2);
+
+	gclib::gc_config config;
+	config.min_heap_bytes = 64 * 1024;
+	gc.set_config(config);
+	evacuation_counter evacuations;
+	gc.set_listener(&evacuations);
+	gclib::string_interner<string_data_header, test_gc> interner(&gc);
+	const auto identifier = [](int i) { return (i % 7 ? "id" : "a much longer identifier ") + std::to_string(i); };
+	std::vector<test_gc::unique_root_type<names>> kept;
+	for (int i = 0; i < 20'000; i++) {
+		kept.push_back(gc.make_unique<names>());
+		gclib::string_data *data = interner.intern(identifier(i % 1000));
+		kept.back()->first.assign(&gc, data);
+		gc.new_<node>(i); // garbage between them, so there is something to evacuate
+	}
+	REQUIRE(interner.size() == 1000);
+	for (int i = 0; i < 3; i++) {
+		for (size_t j = 0; j < kept.size(); j += 3) {
+			kept[j] = gc.make_unique<names>(); // holes in the blocks
+		}
+		gc.collect();
+	}
+	REQUIRE(evacuations.evacuated > 0);
+	for (size_t j = 0; j < kept.size(); j++) {
+		if (j % 3 == 0) {
+			continue;
+		}
+		const std::string expected = identifier(static_cast<int>(j % 1000));
+		REQUIRE(kept[j]->first == std::string_view(expected));
+		REQUIRE(*kept[j]->first.data_ref() == interner.intern(expected)); // the table follows moved strings
+	}
+	for (size_t j = 0; j < kept.size(); j++) {
+		if (j % 1000 >= 500) {
+			kept[j] = nullptr;
+		}
+	}
+	gc.collect();
+	REQUIRE(interner.size() == 500);
+	kept.clear();
+	gc.collect();
+	REQUIRE(interner.size() == 0);
+}
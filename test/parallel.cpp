@@ -0,0 +1,157 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators_all.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <gclib/gc.hpp>
+#include <gclib/parallel.hpp>
+#include "util.hpp"
+
+namespace parallel_test {
+	struct graph_node {
+		uint8_t t;
+		graph_node *a;
+		graph_node *b;
+		graph_node(graph_node *_a=nullptr, graph_node *_b=nullptr) : t(0), a(_a), b(_b) { }
+	};
+	static size_t bytes_of(void *) { return sizeof(graph_node); }
+	static std::optional<void **> ref_begin(void *obj) {
+		graph_node *n = static_cast<graph_node *>(obj);
+		if (n->a) return (void **)&n->a;
+		if (n->b) return (void **)&n->b;
+		return std::nullopt;
+	}
+	static std::optional<void **> ref_next(void *obj, void **prev) {
+		graph_node *n = static_cast<graph_node *>(obj);
+		if (prev == (void **)&n->a && n->b) return (void **)&n->b;
+		return std::nullopt;
+	}
+}
+
+TEST_CASE("work stealing deque") {
+	gclib::work_stealing_deque deque;
+	constexpr size_t count = 100'000;
+	std::vector<uint8_t> taken(count, 0);
+	std::atomic<size_t> taken_count = 0;
+	std::atomic<bool> done = false;
+	const auto take = [&](void *item) {
+		taken[reinterpret_cast<uintptr_t>(item) - 1]++;
+		taken_count++;
+	};
+	std::vector<std::thread> thieves;
+	for (int i = 0; i < 3; i++) {
+		thieves.emplace_back([&]() {
+			while (!done) {
+				if (void *item = deque.steal()) {
+					take(item);
+				}
+			}
+		});
+	}
+	for (size_t i = 0; i < count; i++) {
+		deque.push(reinterpret_cast<void *>(i + 1));
+		if (i % 3 == 0) {
+			if (void *item = deque.pop()) {
+				take(item);
+			}
+		}
+	}
+	while (void *item = deque.pop()) {
+		take(item);
+	}
+	while (!deque.empty()) { }
+	done = true;
+	for (std::thread &t : thieves) {
+		t.join();
+	}
+	REQUIRE(taken_count == count);
+	REQUIRE(std::all_of(taken.begin(), taken.end(), [](uint8_t t) { return t == 1; }));
+}
+TEST_CASE("parallel mark matches serial mark") {
+	using namespace parallel_test;
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	auto edges = GENERATE(randomArray<uint32_t, 20'000>(2, std::uniform_int_distribution<uint32_t>(0, 9'999)));
+	std::vector<gclib::void_gc_uroot<graph_node>> nodes;
+	for (int i = 0; i < 10'000; i++) {
+		nodes.push_back(gc.make_unique<graph_node>());
+	}
+	for (size_t i = 0; i < 10'000; i++) {
+		nodes[i]->a = nodes[edges[2*i]].get();
+		nodes[i]->b = edges[2*i+1] % 3 ? nullptr : nodes[edges[2*i+1]].get();
+	}
+	for (size_t i = 0; i < 10'000; i += 2) {
+		nodes[i] = nullptr;
+	}
+	gc.collect();
+	const uint64_t serial_live = gc.live_object_count();
+	const uint64_t serial_blocks = gc.block_count();
+	gc.set_mark_threads(4);
+	REQUIRE(gc.mark_threads() == 4);
+	gc.collect();
+	REQUIRE(gc.live_object_count() == serial_live);
+	REQUIRE(gc.block_count() <= serial_blocks);
+	gc.set_mark_threads(1);
+	gc.collect();
+	REQUIRE(gc.live_object_count() == serial_live);
+}
+
+TEST_CASE("shared heap with several mutator threads") {
+	using namespace parallel_test;
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gclib::gc_config config;
+	config.min_heap_bytes = 64 * 1024;
+	gc.set_config(config);
+	gc.set_shared_heap(true);
+	REQUIRE(gc.shared_heap());
+	constexpr int threads = 4;
+	constexpr size_t length = 20'000;
+	std::vector<size_t> lengths(threads, 0);
+	std::vector<std::thread> mutators;
+	for (int t = 0; t < threads; t++) {
+		mutators.emplace_back([&, t]() {
+			{
+				gclib::handle_scope scope(gc);
+				gclib::handle<graph_node> head = gc.handle_of(static_cast<graph_node *>(nullptr));
+				for (size_t i = 0; i < length; i++) {
+					graph_node *n = gc.new_<graph_node>();
+					n->t = static_cast<uint8_t>(t);
+					n->a = head.get();
+					head.set(n);
+					gc.new_<graph_node>(); // garbage
+				}
+				for (graph_node *n = head.get(); n; n = n->a) {
+					lengths[t] += n->t == t;
+				}
+			}
+			gc.detach_thread();
+		});
+	}
+	for (std::thread &t : mutators) {
+		t.join();
+	}
+	for (size_t l : lengths) {
+		REQUIRE(l == length);
+	}
+	REQUIRE(gc.major_collection_count() > 1);
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 0);
+	gc.set_shared_heap(false);
+	gclib::void_gc_uroot<graph_node> single = gc.make_unique<graph_node>();
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 1);
+}
+TEST_CASE("shared heap turned on again") {
+	using namespace parallel_test;
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gc.set_shared_heap(true);
+	gclib::void_gc_uroot<graph_node> first = gc.make_unique<graph_node>();
+	gc.set_shared_heap(false);
+	gc.set_shared_heap(true); // the thread's cached mutator was dropped meanwhile
+	gclib::void_gc_uroot<graph_node> second = gc.make_unique<graph_node>();
+	second->a = first.get();
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 2);
+	gc.set_shared_heap(false);
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 2);
+}
@@ -12,6 +12,7 @@ public:
 	virtual size_t bytes() = 0;
 	virtual std::optional<object **> refs_begin() { return std::nullopt; }
 	virtual std::optional<object **> refs_next(object **) { return std::nullopt; }
+	virtual void refs(gclib::ref_list &) { }
 };
 object::~object() { }
 
@@ -32,6 +33,7 @@ public:
 	virtual std::optional<object **> refs_begin() override {
 		return next == nullptr ? std::nullopt : std::optional<object **>((object **)&next);
 	}
+	virtual void refs(gclib::ref_list &list) override { list(&next); }
 	size_t bytes() override { return sizeof(*this); }
 	::linked_list_node<T> &operator[](size_t i) {
 		if (i)
@@ -54,6 +56,10 @@ public:
 	virtual std::optional<object **> refs_next(object **pi) override {
 		return prev == nullptr || (void **)&prev == (void **)pi ? std::nullopt : std::optional<object **>((object **)&prev);
 	}
+	virtual void refs(gclib::ref_list &list) override {
+		list(&next);
+		list(&prev);
+	}
 	size_t bytes() override { return sizeof(*this); }
 	::doubly_linked_list_node<T> &operator[](int64_t i) {
 		if (i > 0)
@@ -151,3 +157,39 @@ TEST_CASE("gc polymorphic tests") {
 }
 
 
+TEST_CASE("gc polymorphic tests with visitor") {
+	gclib::visitor_gc gc(
+		[](void *obj) { return static_cast<object *>(obj)->bytes(); },
+		[](void *obj, gclib::ref_list &list) { static_cast<object *>(obj)->refs(list); }
+	);
+	gclib::visitor_gc_uroot<doubly_linked_list_node<int>> root = gc.make_unique<doubly_linked_list_node<int>>(0);
+	root->next = &*root;
+	root->prev = &*root;
+	auto random_stuff = GENERATE(randomArray<int32_t, 100>(3,
+		std::uniform_int_distribution<int32_t>(-50, 50)));
+	for (int i = 0; i < 100; i++) {
+		gclib::visitor_gc_uroot<doubly_linked_list_node<int>> node(&root->at(random_stuff[i]), &gc);
+		auto res = gc.make_unique<doubly_linked_list_node<int>>(i, nullptr);
+		res->next = node->next;
+		res->prev = node.get();
+		res->next->prev = res.get();
+		res->prev->next = res.get();
+	}
+	gclib::visitor_gc_uroot<linked_list_node<int>> head = gc.make_unique<linked_list_node<int>>(0, nullptr);
+	for (int i = 1; i < 10; i++) {
+		auto new_head = gc.make_unique<linked_list_node<int>>(i, nullptr);
+		new_head->next = head.get();
+		head = std::move(new_head);
+	}
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 111);
+	root->next = &*root;
+	root->prev = &*root;
+	head->at(4).next = &head->at(8);
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 8);
+	root = nullptr;
+	head = nullptr;
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 0);
+}
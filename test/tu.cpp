@@ -1,6 +1,7 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators_all.hpp>
 #include <numeric>
+#include <sstream>
 #include <vector>
 #include <gclib/gc.hpp>
 #include <gclib/util.hpp>
@@ -72,6 +73,23 @@ static std::optional<void **> ref_next(void *obj, void **prev) {
 	return std::nullopt;
 }
 
+struct tu_policy {
+	static size_t size(void *obj) { return bytes_of(obj); }
+	template<typename Visitor>
+	static void trace(void *obj, Visitor &visit) {
+		switch (*(tag *)obj) {
+		case tag_vec_int: visit(((gcivec *)obj)->_gc.data_ref()); break;
+		case tag_link_ilist: visit(&((link_ilist *)obj)->next); break;
+		case tag_big_link_list: visit(&((big_link_list *)obj)->next); break;
+		case tag_int:
+		case tag_vec_data:
+		case tag_big_object:
+			break;
+		}
+	}
+};
+using tu_gc = gclib::basic_gc<tu_policy>;
+
 TEST_CASE("gc tag union tests 80k ints") {
 	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
 	std::vector<gclib::void_gc_uroot<tag>> objs;
@@ -96,6 +114,274 @@ TEST_CASE("gc tag union tests 80k ints") {
 	gc.collect();
 	REQUIRE(gc.live_object_count() == 0);
 }
+TEST_CASE("gc tag union tests reuse swept blocks") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	std::vector<gclib::void_gc_uroot<tag>> objs;
+	for (int i = 0; i < 80'000; i++) {
+		objs.push_back(gc.make_unique_as<gcint, tag>(i));
+	}
+	const uint64_t blocks = gc.block_count();
+	objs.clear();
+	gc.collect();
+	for (int i = 0; i < 80'000; i++) {
+		objs.push_back(gc.make_unique_as<gcint, tag>(i));
+	}
+	REQUIRE(gc.block_count() == blocks);
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 80'000);
+	for (int i = 0; i < 80'000; i++) {
+		REQUIRE(objs[i].as<gcint>()->data == i);
+	}
+}
+TEST_CASE("block pool recycles freed blocks") {
+	std::vector<gclib::block *> taken;
+	for (size_t i = 0; i < 3 * gclib::block_arena_blocks; i++) {
+		taken.push_back(gclib::alloc_block());
+		REQUIRE(reinterpret_cast<uintptr_t>(taken.back()) % gclib::block_size == 0);
+	}
+	gclib::block *last = taken.back();
+	taken.pop_back();
+	gclib::free_block(last);
+	gclib::block *reused = gclib::alloc_block();
+	REQUIRE(reused == last);
+	REQUIRE(!reused->is_full());
+	taken.push_back(reused);
+	for (gclib::block *b : taken) {
+		gclib::free_block(b);
+	}
+}
+TEST_CASE("gc tag union tests evacuation") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gclib::void_gc_uroot<link_ilist> kept = gc.make_unique<link_ilist>(0);
+	std::vector<gclib::void_gc_uroot<tag>> dropped;
+	for (int i = 1; i < 200'000; i++) {
+		if (i % 16) {
+			dropped.push_back(gc.make_unique_as<gcint, tag>(i));
+		} else {
+			gclib::void_gc_uroot<link_ilist> new_node = gc.make_unique<link_ilist>(i);
+			new_node->next = kept.get();
+			kept = std::move(new_node);
+		}
+	}
+	dropped.clear();
+	gc.collect();
+	const uint64_t fragmented_blocks = gc.block_count();
+	// the line marks of the first collection show the holes, the next ones evacuate
+	for (int i = 0; i < 4; i++) {
+		gc.collect();
+	}
+	REQUIRE(gc.block_count() < fragmented_blocks);
+	REQUIRE(gc.live_object_count() == 200'000 / 16);
+	int expected = 200'000 - 16;
+	for (link_ilist *n = kept.get(); n; n = n->next, expected -= 16) {
+		REQUIRE(n->data == expected);
+	}
+	REQUIRE(expected == -16);
+}
+TEST_CASE("gc tag union tests evacuation by live bytes") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gclib::gc_config config;
+	config.min_heap_bytes = 64 * 1024 * 1024; // only the collections below
+	config.compact_ratio = 2;
+	config.evacuation_budget_bytes = 0;
+	gc.set_config(config);
+	gclib::void_gc_uroot<link_ilist> sparse = gc.make_unique<link_ilist>(0);
+	gclib::void_gc_uroot<link_ilist> dense = gc.make_unique<link_ilist>(0);
+	const auto build = [&gc](gclib::void_gc_uroot<link_ilist> &list, int groups, int live, int garbage) {
+		for (int i = 0; i < groups; i++) {
+			for (int j = 0; j < live; j++) {
+				link_ilist *n = gc.new_<link_ilist>(i, list.get());
+				list = gclib::void_gc_uroot<link_ilist>(n, &gc);
+			}
+			for (int j = 0; j < garbage; j++) {
+				gc.new_<gcint>(j);
+			}
+		}
+	};
+	build(sparse, 2'000, 1, 15); // about 6% live, with a hole after most nodes
+	build(dense, 2'500, 32, 16); // about 65% live, with a hole between the runs
+	const auto nodes = [](link_ilist *n) {
+		std::vector<link_ilist *> out;
+		for (; n; n = n->next) {
+			out.push_back(n);
+		}
+		return out;
+	};
+	const auto moved = [&nodes](link_ilist *list, const std::vector<link_ilist *> &before) {
+		const std::vector<link_ilist *> after = nodes(list);
+		REQUIRE(after.size() == before.size());
+		size_t count = 0;
+		for (size_t i = 0; i < after.size(); i++) {
+			count += after[i] != before[i];
+		}
+		return count;
+	};
+	gc.collect(); // the blocks weren't marked before, so nothing is evacuated yet
+	REQUIRE(gc.last_collection_stats().evacuated_objects == 0);
+	const gclib::collection_stats &measured = gc.last_collection_stats();
+	REQUIRE(std::accumulate(std::begin(measured.live_histogram), std::end(measured.live_histogram), uint64_t(0)) == measured.blocks);
+	REQUIRE(measured.live_histogram[0] > 0);
+	REQUIRE(measured.live_histogram[6] > 0);
+	const std::vector<link_ilist *> sparse_before = nodes(sparse.get());
+	const std::vector<link_ilist *> dense_before = nodes(dense.get());
+	gc.collect();
+	REQUIRE(gc.last_collection_stats().evacuated_objects > 0);
+	REQUIRE(moved(sparse.get(), sparse_before) > sparse_before.size() / 2);
+	// too full to be worth copying, though the cap had room - only the block shared with the sparse list moved
+	REQUIRE(moved(dense.get(), dense_before) < dense_before.size() / 20);
+
+	config.evacuation_budget_bytes = 16 * 1024;
+	gc.set_config(config);
+	build(sparse, 2'000, 1, 15);
+	gc.collect();
+	gc.collect();
+	REQUIRE(gc.last_collection_stats().evacuated_objects > 0);
+	REQUIRE(gc.last_collection_stats().evacuated_bytes <= config.evacuation_budget_bytes);
+	REQUIRE(gc.live_object_count() == 2 + 4'000 + 2'500 * 32);
+}
+TEST_CASE("gc tag union tests weak references") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gclib::void_gc_uroot<link_ilist> kept = gc.make_unique<link_ilist>(0);
+	gclib::void_gc_weak<link_ilist> to_kept(kept.get(), &gc);
+	gclib::void_gc_weak<gcint> to_dropped(gc.new_<gcint>(1), &gc);
+	gclib::void_gc_ephemeron_map<link_ilist, link_ilist> map(&gc);
+	// fragmented blocks, so the live objects get evacuated by the collections after the first one
+	std::vector<gclib::void_gc_uroot<tag>> dropped;
+	for (int i = 0; i < 100'000; i++) {
+		if (i % 16) {
+			dropped.push_back(gc.make_unique_as<gcint, tag>(i));
+		} else {
+			gclib::handle_scope scope(gc);
+			gclib::handle<link_ilist> key = gc.make_handle<link_ilist>(i);
+			gclib::handle<link_ilist> value = gc.make_handle<link_ilist>(-i);
+			value->next = key.get(); // refers to its key, but doesn't keep it alive
+			map.set(key.get(), value.get());
+			if (i % 32 == 0) { // kept -> holder -> key -> holder -> key ...
+				key->next = kept->next;
+				link_ilist *holder = gc.new_<link_ilist>(i);
+				holder->next = key.get();
+				kept->next = holder;
+			}
+		}
+	}
+	dropped.clear();
+	REQUIRE(map.size() == 100'000 / 16);
+	std::vector<link_ilist *> keys_before;
+	for (link_ilist *holder = kept->next; holder; holder = holder->next->next) {
+		keys_before.push_back(holder->next);
+	}
+	for (int i = 0; i < 5; i++) {
+		gc.collect();
+	}
+	REQUIRE(to_dropped.expired());
+	REQUIRE(to_kept.get() == kept.get());
+	REQUIRE(map.size() == (100'000 + 31) / 32);
+	size_t moved = 0;
+	size_t i = 0;
+	for (link_ilist *holder = kept->next; holder; holder = holder->next->next, i++) {
+		moved += holder->next != keys_before[i]; // evacuated, the map has to follow
+		link_ilist *value = map.get(holder->next);
+		REQUIRE(value != nullptr);
+		REQUIRE(value->data == -holder->data);
+		REQUIRE(value->next == holder->next);
+	}
+	REQUIRE(moved > 0);
+	kept->next = nullptr;
+	gc.collect();
+	REQUIRE(map.size() == 0);
+	REQUIRE(gc.live_object_count() == 1);
+}
+struct counting_listener : gclib::gc_listener {
+	std::vector<uint64_t> started;
+	std::vector<gclib::collection_stats> ended;
+	void collection_start(const gclib::collection_stats &stats) override { started.push_back(stats.number); }
+	void collection_end(const gclib::collection_stats &stats) override { ended.push_back(stats); }
+};
+TEST_CASE("gc tag union tests stats") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	counting_listener listener;
+	std::ostringstream trace;
+	gclib::chrome_trace_writer writer(trace);
+	gc.set_listener(&listener);
+	gclib::void_gc_uroot<link_ilist> kept = gc.make_unique<link_ilist>(0);
+	for (int i = 1; i < 100'000; i++) {
+		gc.new_<gcint>(i);
+		if (i % 16 == 0) {
+			gclib::void_gc_uroot<link_ilist> new_node = gc.make_unique<link_ilist>(i);
+			new_node->next = kept.get();
+			kept = std::move(new_node);
+		}
+	}
+	gc.collect();
+	gc.set_listener(&writer);
+	gc.collect();
+	gc.set_listener(&listener);
+	gc.collect();
+	const gclib::collection_stats &last = gc.last_collection_stats();
+	REQUIRE(last.number == gc.major_collection_count());
+	REQUIRE(last.kind == gclib::collection_kind::full);
+	REQUIRE(last.marked_objects == 100'000 / 16);
+	REQUIRE(last.marked_bytes == gc.live_byte_count());
+	REQUIRE(last.blocks == gc.block_count());
+	REQUIRE(last.pause >= last.phases.mark);
+	REQUIRE(std::accumulate(std::begin(last.hole_histogram), std::end(last.hole_histogram), uint64_t(0)) == last.blocks);
+	REQUIRE(std::accumulate(std::begin(last.live_histogram), std::end(last.live_histogram), uint64_t(0)) == last.blocks);
+	REQUIRE(listener.ended.size() == listener.started.size());
+	REQUIRE(listener.ended.size() == gc.major_collection_count() - 1);
+	uint64_t evacuated = 0;
+	for (const gclib::collection_stats &stats : listener.ended) {
+		evacuated += stats.evacuated_objects;
+	}
+	REQUIRE(evacuated > 0); // the fragmented blocks of the first collections got evacuated
+	REQUIRE(listener.ended.front().allocated_bytes >= 99'999 * gclib::max_align);
+	REQUIRE(trace.str().find("\"full collection\"") != std::string::npos);
+}
+TEST_CASE("gc tag union tests heap snapshot") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	// a -> b -> c <- d, with a and d rooted
+	gclib::void_gc_uroot<link_ilist> a = gc.make_unique<link_ilist>(0);
+	a->next = gc.new_<link_ilist>(1);
+	a->next->next = gc.new_<link_ilist>(2);
+	gclib::void_gc_uroot<link_ilist> d = gc.make_unique<link_ilist>(3);
+	d->next = a->next->next;
+	gc.new_<gcint>(4);
+	gc.new_<gcbig_object>();
+	std::stringstream dump;
+	gc.dump_heap(dump, [](void *obj) { return *(tag *)obj; });
+	const gclib::heap_snapshot snapshot = gclib::heap_snapshot::read(dump);
+	REQUIRE(snapshot.block_size == gclib::block::block_size);
+	REQUIRE(snapshot.blocks.size() == gc.block_count());
+	REQUIRE(snapshot.roots.size() == 2);
+	REQUIRE(snapshot.objects.size() == 4);
+	const std::vector<uint64_t> retained = snapshot.retained_sizes();
+	const uint64_t link_bytes = bytes_of(a.get());
+	const size_t ia = snapshot.find(reinterpret_cast<uintptr_t>(a.get()));
+	const size_t ic = snapshot.find(reinterpret_cast<uintptr_t>(d->next));
+	REQUIRE(snapshot.objects[ia].tag == tag_link_ilist);
+	REQUIRE(snapshot.objects[ia].refs.size() == 1);
+	REQUIRE(retained[ia] == 2 * link_bytes); // c is shared with d
+	REQUIRE(retained[ic] == link_bytes);
+	REQUIRE(retained[snapshot.find(reinterpret_cast<uintptr_t>(d.get()))] == link_bytes);
+	REQUIRE(snapshot.dominators()[ic] == snapshot.objects.size());
+	std::stringstream broken("GCHEAP01 and then nothing useful");
+	REQUIRE_THROWS_AS(gclib::heap_snapshot::read(broken), std::runtime_error);
+}
+TEST_CASE("gc tag union tests heap snapshot follows ephemerons") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gclib::void_gc_ephemeron_map<link_ilist, link_ilist> map(&gc);
+	// a => b => c through the map, with a rooted, and d => e with nothing keeping d
+	gclib::void_gc_uroot<link_ilist> a = gc.make_unique<link_ilist>(0);
+	link_ilist *b = gc.new_<link_ilist>(1);
+	link_ilist *c = gc.new_<link_ilist>(2);
+	map.set(b, c);
+	map.set(a.get(), b);
+	map.set(gc.new_<link_ilist>(3), gc.new_<link_ilist>(4));
+	std::stringstream dump;
+	gc.dump_heap(dump);
+	const gclib::heap_snapshot snapshot = gclib::heap_snapshot::read(dump);
+	REQUIRE(snapshot.objects.size() == 3);
+	REQUIRE(snapshot.find(reinterpret_cast<uintptr_t>(c)) < snapshot.objects.size());
+}
 TEST_CASE("gc tag union tests 100 big objects") {
 	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
 	std::vector<gclib::void_gc_uroot<tag>> objs;
@@ -108,6 +394,22 @@ TEST_CASE("gc tag union tests 100 big objects") {
 	gc.collect();
 	REQUIRE(gc.live_object_count() == 0);
 }
+TEST_CASE("gc tag union tests big objects reuse freed pages") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	std::vector<gclib::void_gc_uroot<tag>> objs;
+	for (int i = 0; i < 10; i++) {
+		objs.push_back(gc.make_unique_as<gcbig_object, tag>());
+	}
+	tag *kept = objs[5].get();
+	void *freed = objs[3].get();
+	objs[3] = nullptr;
+	gc.collect();
+	REQUIRE(gc.big_object_count() == 9);
+	REQUIRE(objs[5].get() == kept);
+	objs.push_back(gc.make_unique_as<gcbig_object, tag>());
+	REQUIRE(objs.back().get() == freed);
+	REQUIRE(gc.big_object_count() == 10);
+}
 TEST_CASE("gc tag union tests 80k int ivec") {
 	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
 	gclib::void_gc_uroot<gcivec> v = gc.make_unique<gcivec>(&gc);
@@ -120,6 +422,76 @@ TEST_CASE("gc tag union tests 80k int ivec") {
 	gc.collect();
 	REQUIRE(gc.live_object_count() == 0);
 }
+TEST_CASE("gc tag union tests ivec grows in place") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gclib::void_gc_uroot<gcivec> v = gc.make_unique<gcivec>(&gc);
+	v->_gc.push_back(0);
+	const void *data = *v->_gc.data_ref();
+	for (int i = 1; i < 1000; i++) {
+		v->_gc.push_back(i);
+	}
+	REQUIRE(*v->_gc.data_ref() == data); // nothing was allocated after it
+	gclib::void_gc_uroot<gcint> other = gc.make_unique<gcint>(0);
+	while (v->_gc.size() < v->_gc.capacity()) {
+		v->_gc.push_back(static_cast<int>(v->_gc.size()));
+	}
+	v->_gc.push_back(static_cast<int>(v->_gc.size()));
+	REQUIRE(*v->_gc.data_ref() != data);
+	gc.start_concurrent_collect(); // grown data allocated during marking has to survive it
+	for (int i = static_cast<int>(v->_gc.size()); i < 1500; i++) {
+		v->_gc.push_back(i);
+	}
+	gc.finish_concurrent_collect();
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 3);
+	for (int i = 0; i < 1500; i++) {
+		REQUIRE(v->_gc[i] == i);
+	}
+}
+TEST_CASE("gc tag union tests old ivec grows in place") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gc.set_generational(true);
+	gc.collect();
+	gclib::void_gc_uroot<gcivec> v = gc.make_unique<gcivec>(&gc);
+	v->_gc.reserve(20);
+	const uint8_t *data = static_cast<const uint8_t *>(*v->_gc.data_ref());
+	REQUIRE(reinterpret_cast<uintptr_t>(data + gclib::bytes_vec_data<int>(*v->_gc.data_ref())) % gclib::line_size == 0);
+	for (int i = 0; i < 20; i++) {
+		v->_gc.push_back(i);
+	}
+	gc.collect_minor(); // it's old now, minor collections don't mark it again
+	for (int i = 20; i < 30; i++) {
+		v->_gc.push_back(i);
+	}
+	REQUIRE(*v->_gc.data_ref() == data); // its new part is on a line of its own
+	gc.collect_minor();
+	std::vector<gclib::void_gc_uroot<gcint>> ints;
+	for (int i = 0; i < 64; i++) {
+		ints.push_back(gc.make_unique<gcint>(-1));
+	}
+	for (int i = 0; i < 30; i++) {
+		REQUIRE(v->_gc[i] == i);
+	}
+}
+TEST_CASE("gc tag union tests big ivec grows without copies") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gc.set_generational(true);
+	gclib::void_gc_uroot<gcivec> v = gc.make_unique<gcivec>(&gc);
+	v->_gc.reserve(gclib::big_object_treshold);
+	gc.collect(); // makes the data old, with the holder remembered when it's written to
+	for (int i = 0; i < 1'000'000; i++) {
+		v->_gc.push_back(i);
+	}
+#ifdef __linux__
+	REQUIRE(gc.big_object_count() == 1); // remapped, no old data left behind
+#endif
+	gc.collect_minor();
+	gc.collect();
+	REQUIRE(gc.big_object_count() == 1);
+	for (int i = 0; i < 1'000'000; i++) {
+		REQUIRE(v->_gc[i] == i);
+	}
+}
 TEST_CASE("gc tag union tests 20 big link nodes in 3 lists") {
 	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
 	auto list_sel = GENERATE(randomArray<uint8_t, 20>(1, std::uniform_int_distribution<uint8_t>(0, 2)));
@@ -187,3 +559,234 @@ TEST_CASE("gc tag union tests 500k link nodes in 3 lists") {
 	REQUIRE(gc.live_object_count() == list2_sz);
 }
 
+TEST_CASE("gc tag union tests static policy") {
+	tu_gc gc;
+	auto list_sel = GENERATE(randomArray<uint8_t, 100'000>(1, std::uniform_int_distribution<uint8_t>(0, 1)));
+	tu_gc::unique_root_type<link_ilist> list0 = gc.make_unique<link_ilist>(0);
+	tu_gc::unique_root_type<link_ilist> list1 = gc.make_unique<link_ilist>(1);
+	size_t list1_sz = 1;
+	for (int i = 2; i < 100'000; i++) {
+		auto &list = list_sel[i] ? list1 : list0;
+		tu_gc::unique_root_type<link_ilist> new_node = gc.make_unique<link_ilist>(i);
+		new_node->next = list.get();
+		list = std::move(new_node);
+		gc.new_<big_link_list>(nullptr);
+		list1_sz += list_sel[i];
+	}
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 100'000);
+	REQUIRE(gc.big_object_count() == 0);
+	list1 = nullptr;
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 100'000 - list1_sz);
+	int last = 100'000;
+	for (link_ilist *n = list0.get(); n; n = n->next) {
+		REQUIRE(n->data < last);
+		REQUIRE((n->data == 0 || !list_sel[n->data]));
+		last = n->data;
+	}
+}
+template<typename Geometry>
+static void run_list_workload() {
+	using geometry_gc = gclib::basic_gc<tu_policy, Geometry>;
+	geometry_gc gc;
+	typename geometry_gc::template unique_root_type<link_ilist> list = gc.template make_unique<link_ilist>(0);
+	for (int i = 1; i < 50'000; i++) {
+		typename geometry_gc::template unique_root_type<link_ilist> new_node = gc.template make_unique<link_ilist>(i);
+		new_node->next = list.get();
+		list = std::move(new_node);
+		gc.template new_<gcint>(i);
+		if (i % 100 == 0) {
+			gc.template new_<gcbig_object>();
+		}
+	}
+	for (int i = 0; i < 3; i++) {
+		gc.collect();
+	}
+	REQUIRE(gc.live_object_count() == 50'000);
+	int expected = 49'999;
+	for (link_ilist *n = list.get(); n; n = n->next, expected--) {
+		REQUIRE(n->data == expected);
+	}
+}
+TEST_CASE("gc tag union tests heap geometries") {
+	run_list_workload<gclib::heap_geometry<64, 32 * 1024>>();
+	run_list_workload<gclib::heap_geometry<256, 64 * 1024>>();
+	run_list_workload<gclib::heap_geometry<128, 256 * 1024, 8 * 1024>>();
+}
+TEST_CASE("gc tag union tests handle scopes") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	{
+		gclib::handle_scope outer(gc);
+		gclib::handle<link_ilist> list = gc.make_handle<link_ilist>(0);
+		for (int i = 1; i < 5'000; i++) {
+			gclib::handle_scope inner(gc);
+			gclib::handle<link_ilist> node = gc.make_handle<link_ilist>(i);
+			node->next = list.get();
+			list.set(node.get());
+			for (int j = 0; j < 3; j++) {
+				gc.make_handle_as<gcint, tag>(j);
+			}
+		}
+		std::vector<gclib::handle<tag>> many;
+		for (int i = 0; i < 3 * int(gclib::handle_chunk_size); i++) {
+			many.push_back(gc.make_handle_as<gcint, tag>(i));
+		}
+		gc.collect();
+		REQUIRE(gc.live_object_count() == 5'000 + many.size());
+		int expected = 4'999;
+		for (link_ilist *n = list.get(); n; n = n->next, expected--) {
+			REQUIRE(n->data == expected);
+		}
+		for (size_t i = 0; i < many.size(); i++) {
+			REQUIRE(many[i].as<gcint>()->data == int(i));
+		}
+	}
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 0);
+}
+TEST_CASE("gc tag union tests byte pacing") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gclib::gc_config config;
+	config.min_heap_bytes = 1024 * 1024;
+	gc.set_config(config);
+	gclib::void_gc_uroot<gcint> kept = gc.make_unique<gcint>(1);
+	for (int i = 0; i < 200; i++) { // big objects count too
+		gc.new_<gcbig_object>();
+	}
+	REQUIRE(gc.major_collection_count() >= 1);
+	gc.collect();
+	REQUIRE(gc.live_byte_count() == gclib::max_align);
+	const uint64_t collections = gc.major_collection_count();
+	config.max_heap_bytes = 256 * 1024;
+	gc.set_config(config);
+	for (int i = 0; i < 80'000; i++) {
+		gc.new_<gcint>(i);
+	}
+	REQUIRE(gc.major_collection_count() - collections >= 1'000'000 / config.max_heap_bytes);
+	REQUIRE(kept->data == 1);
+	REQUIRE(gc.pause_count() == gc.major_collection_count());
+	REQUIRE(gc.last_pause() > std::chrono::steady_clock::duration::zero());
+}
+TEST_CASE("gc tag union tests generational") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gc.set_generational(true);
+	gclib::void_gc_uroot<link_ilist> old = gc.make_unique<link_ilist>(0);
+	gclib::void_gc_uroot<gcivec> v = gc.make_unique<gcivec>(&gc);
+	gc.collect_minor(); // no full collection yet, so this is a full one
+	REQUIRE(gc.major_collection_count() == 1);
+	REQUIRE(gc.live_object_count() == 2);
+	for (int i = 0; i < 1000; i++) {
+		gc.new_<link_ilist>(i);
+	}
+	gc.new_<gcbig_object>();
+	link_ilist *young = gc.new_<link_ilist>(1);
+	gc.write_barrier(old.get());
+	old->next = young;
+	for (int i = 0; i < 100; i++) {
+		v->_gc.push_back(i);
+	}
+	const uint64_t minor_count = gc.minor_collection_count();
+	const uint64_t major_count = gc.major_collection_count();
+	gc.collect_minor();
+	REQUIRE(gc.minor_collection_count() + gc.major_collection_count() == minor_count + major_count + 1);
+	REQUIRE(gc.live_object_count() == 4);
+	REQUIRE(gc.big_object_count() == 0);
+	REQUIRE(old->next->data == 1);
+	for (int i = 0; i < 100; i++) {
+		REQUIRE(v->_gc[i] == i);
+	}
+	gc.write_barrier(old.get());
+	old->next = nullptr;
+	gc.collect_minor();
+	REQUIRE(gc.live_object_count() == 4); // the promoted node is only freed by a full collection
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 3);
+}
+TEST_CASE("gc tag union tests concurrent mark") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gclib::void_gc_uroot<link_ilist> list = gc.make_unique<link_ilist>(0);
+	for (int i = 1; i < 10'000; i++) {
+		gclib::void_gc_uroot<link_ilist> new_node = gc.make_unique<link_ilist>(i, nullptr);
+		new_node->next = list.get();
+		list = std::move(new_node);
+	}
+	gclib::void_gc_uroot<gcivec> v = gc.make_unique<gcivec>(&gc);
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 10'001);
+	gc.start_concurrent_collect();
+	REQUIRE(gc.concurrent_collect_running());
+	link_ilist *cut = &*list;
+	for (int i = 0; i < 5'000; i++) {
+		cut = cut->next;
+	}
+	gc.write_barrier(cut);
+	cut->next = nullptr; // the 4'999 nodes after cut are still in the snapshot
+	for (int i = 0; i < 1'000; i++) {
+		v->_gc.push_back(i);
+	}
+	gc.finish_concurrent_collect();
+	REQUIRE(!gc.concurrent_collect_running());
+	REQUIRE(gc.live_object_count() >= 10'003);
+	for (int i = 0; i < 1'000; i++) {
+		REQUIRE(v->_gc[i] == i);
+	}
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 5'001 + 2);
+	gclib::gc_config config;
+	config.min_heap_bytes = 256 * 1024;
+	gc.set_config(config);
+	gc.set_concurrent(true);
+	for (int i = 0; i < 100'000; i++) {
+		gclib::void_gc_uroot<link_ilist> new_node = gc.make_unique<link_ilist>(i, nullptr);
+		gc.write_barrier(new_node.get());
+		new_node->next = list.get();
+		list = std::move(new_node);
+	}
+	gc.finish_concurrent_collect();
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 105'001 + 2);
+}
+TEST_CASE("gc tag union tests incremental collection") {
+	gclib::void_gc gc(bytes_of, ref_begin, ref_next);
+	gclib::void_gc_uroot<link_ilist> list = gc.make_unique<link_ilist>(0);
+	for (int i = 1; i < 100'000; i++) {
+		gclib::void_gc_uroot<link_ilist> new_node = gc.make_unique<link_ilist>(i, nullptr);
+		new_node->next = list.get();
+		list = std::move(new_node);
+	}
+	gc.collect();
+	size_t steps = 1;
+	bool cut = false;
+	while (!gc.collect_step(std::chrono::microseconds(50))) {
+		steps++;
+		if (!cut) { // drop the second half of the list while marking runs
+			link_ilist *mid = &*list;
+			for (int i = 1; i < 50'000; i++) {
+				mid = mid->next;
+			}
+			gc.write_barrier(mid);
+			mid->next = nullptr;
+			cut = true;
+		}
+		gclib::void_gc_uroot<link_ilist> new_node = gc.make_unique<link_ilist>(-1, nullptr);
+		gc.write_barrier(new_node.get());
+		new_node->next = list.get();
+		list = std::move(new_node);
+	}
+	REQUIRE(steps > 1);
+	REQUIRE(!gc.concurrent_collect_running());
+	REQUIRE(gc.live_object_count() >= 100'000 + steps - 1);
+	gc.collect();
+	REQUIRE(gc.live_object_count() == 50'000 + steps - 1);
+	int expected = 99'999;
+	link_ilist *node = &*list;
+	for (size_t i = 0; i < steps - 1; i++) {
+		REQUIRE(node->data == -1);
+		node = node->next;
+	}
+	for (; node; node = node->next) {
+		REQUIRE(node->data == expected--);
+	}
+	REQUIRE(expected == 49'999);
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <bit>
+#include <exception>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+#include <gclib/snapshot.hpp>
+
+// reads a snapshot written by gc.dump_heap() and reports what fills the heap and what keeps it alive
+
+namespace {
+	constexpr size_t occupancy_buckets = 10;
+
+	struct tag_totals {
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+		uint64_t retained = 0;
+	};
+
+	/**
+	 * retained bytes of each tag - the retained sizes of objects with that tag which aren't dominated by
+	 * another one with the same tag, so nothing is counted twice
+	 */
+	void add_retained_by_tag(const gclib::heap_snapshot &snapshot, const std::vector<size_t> &idom,
+			const std::vector<uint64_t> &retained, std::unordered_map<uint32_t, tag_totals> &tags) {
+		const size_t n = snapshot.objects.size();
+		std::vector<std::vector<size_t>> children(n);
+		std::vector<size_t> stack;
+		for (size_t i = 0; i < n; i++) {
+			(idom[i] == n ? stack : children[idom[i]]).push_back(i);
+		}
+		std::unordered_map<uint32_t, size_t> on_path; // objects of each tag among the dominators of the current one
+		std::vector<bool> entered(n, false);
+		while (!stack.empty()) {
+			const size_t node = stack.back();
+			const uint32_t tag = snapshot.objects[node].tag;
+			if (entered[node]) {
+				on_path[tag]--;
+				stack.pop_back();
+				continue;
+			}
+			entered[node] = true;
+			if (on_path[tag]++ == 0) {
+				tags[tag].retained += retained[node];
+			}
+			stack.insert(stack.end(), children[node].begin(), children[node].end());
+		}
+	}
+	void print_histogram(const char *title, const std::vector<uint64_t> &buckets) {
+		std::printf("\n%s\n", title);
+		const uint64_t most = std::max<uint64_t>(1, *std::max_element(buckets.begin(), buckets.end()));
+		for (size_t i = 0; i < buckets.size(); i++) {
+			std::printf("%3zu-%3zu%% %8llu ", i * 100 / buckets.size(), (i + 1) * 100 / buckets.size(),
+				static_cast<unsigned long long>(buckets[i]));
+			for (uint64_t j = 0; j < buckets[i] * 50 / most; j++) {
+				std::putchar('#');
+			}
+			std::putchar('\n');
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s snapshot [roots to list]\n", argv[0]);
+		return 2;
+	}
+	const size_t listed_roots = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20;
+	gclib::heap_snapshot snapshot;
+	try {
+		std::ifstream in(argv[1], std::ios::binary);
+		snapshot = gclib::heap_snapshot::read(in);
+	} catch (const std::exception &e) {
+		std::fprintf(stderr, "%s: %s\n", argv[1], e.what());
+		return 1;
+	}
+	const size_t n = snapshot.objects.size();
+	const std::vector<size_t> idom = snapshot.dominators();
+	const std::vector<uint64_t> retained = snapshot.retained_sizes();
+
+	uint64_t live_bytes = 0;
+	uint64_t big_objects = 0;
+	std::unordered_map<uint32_t, tag_totals> tags;
+	std::unordered_map<uint64_t, uint64_t> block_live_bytes;
+	for (const gclib::heap_snapshot::object &o : snapshot.objects) {
+		live_bytes += o.size;
+		tags[o.tag].count++;
+		tags[o.tag].bytes += o.size;
+		if (o.size > snapshot.big_object_treshold) {
+			big_objects++;
+		} else {
+			block_live_bytes[o.address & ~(uint64_t(snapshot.block_size) - 1)] += o.size;
+		}
+	}
+	add_retained_by_tag(snapshot, idom, retained, tags);
+	std::printf("%zu live objects, %llu bytes, %zu blocks of %u bytes, %llu big objects, %zu roots\n", n,
+		static_cast<unsigned long long>(live_bytes), snapshot.blocks.size(), snapshot.block_size,
+		static_cast<unsigned long long>(big_objects), snapshot.roots.size());
+
+	std::vector<std::pair<uint32_t, tag_totals>> by_tag(tags.begin(), tags.end());
+	std::sort(by_tag.begin(), by_tag.end(), [](const auto &a, const auto &b) { return a.second.retained > b.second.retained; });
+	std::printf("\n%10s %12s %14s %14s\n", "tag", "objects", "bytes", "retained");
+	for (const auto &[tag, totals] : by_tag) {
+		std::printf("%10u %12llu %14llu %14llu\n", tag, static_cast<unsigned long long>(totals.count),
+			static_cast<unsigned long long>(totals.bytes), static_cast<unsigned long long>(totals.retained));
+	}
+
+	// an object only some of the roots reach is dominated by the roots together and retained by none of them
+	std::vector<std::pair<uint64_t, const gclib::heap_snapshot::root *>> by_root;
+	for (const gclib::heap_snapshot::root &r : snapshot.roots) {
+		const size_t i = snapshot.find(r.object);
+		by_root.push_back({ i == n ? 0 : retained[i], &r });
+	}
+	std::sort(by_root.begin(), by_root.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+	std::printf("\n%18s %18s %10s %14s\n", "root slot", "object", "tag", "retained");
+	for (size_t i = 0; i < std::min(listed_roots, by_root.size()); i++) {
+		const gclib::heap_snapshot::root &r = *by_root[i].second;
+		const size_t o = snapshot.find(r.object);
+		std::printf("%#18llx %#18llx %10u %14llu\n", static_cast<unsigned long long>(r.slot),
+			static_cast<unsigned long long>(r.object), o == n ? 0 : snapshot.objects[o].tag,
+			static_cast<unsigned long long>(by_root[i].first));
+	}
+
+	std::vector<uint64_t> byte_occupancy(occupancy_buckets);
+	std::vector<uint64_t> line_occupancy(occupancy_buckets);
+	const size_t lines_per_block = snapshot.block_size / snapshot.line_size;
+	for (const gclib::heap_snapshot::block &b : snapshot.blocks) {
+		const auto it = block_live_bytes.find(b.address);
+		const uint64_t bytes = it == block_live_bytes.end() ? 0 : it->second;
+		byte_occupancy[std::min(occupancy_buckets - 1, bytes * occupancy_buckets / snapshot.block_size)]++;
+		size_t used_lines = 0;
+		for (uint64_t group : b.lines) {
+			used_lines += std::popcount(group);
+		}
+		line_occupancy[std::min(occupancy_buckets - 1, used_lines * occupancy_buckets / lines_per_block)]++;
+	}
+	print_histogram("blocks by live bytes", byte_occupancy);
+	print_histogram("blocks by marked lines (block metadata included)", line_occupancy);
+}